@@ -0,0 +1,140 @@
+// Output backpressure: pending output while the server stops reading.
+// The peer of a socketpair is paused while the client keeps producing frames (damage + commit).
+// A client that skips frames while `would_block()` is true keeps its pending output below the high watermark;
+// one that ignores it buffers everything.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/unix_socket_engine.hpp>
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+namespace bench = dd99::wayland::bench;
+
+
+
+// counts watermark events
+struct client_engine final : dd99::wayland::unix_socket_engine
+{
+    using unix_socket_engine::unix_socket_engine;
+
+    void on_output_high_watermark() override { ++high_watermark_count; }
+    void on_output_drained() override { ++drained_count; }
+
+    std::size_t high_watermark_count = 0;
+    std::size_t drained_count = 0;
+};
+
+
+// the server end of the connection: it reads only when asked to
+struct paused_server
+{
+    paused_server()
+    {
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+            throw std::system_error{errno, std::system_category(), "socketpair"};
+    }
+
+    paused_server(const paused_server &) = delete;
+    paused_server & operator=(const paused_server &) = delete;
+
+    ~paused_server() { ::close(fds[1]); }
+
+    // the client end (owned by the engine)
+    int client_fd() const { return fds[0]; }
+
+    void read_all()
+    {
+        std::vector<char> buffer(1 << 20);
+        while (::recv(fds[1], buffer.data(), buffer.size(), MSG_DONTWAIT) > 0) { }
+    }
+
+    int fds[2] = {-1, -1};
+};
+
+
+struct client
+{
+    explicit client(client_engine & eng)
+        : display{eng}
+        , registry{eng}
+        , compositor{eng}
+        , surface{eng}
+    {
+        eng.bind_display(display);
+        display.get_registry(registry);
+        registry.bind(1, "wl_compositor", 4, compositor);
+        compositor.create_surface(surface);
+    }
+
+    void frame(std::size_t i)
+    {
+        const auto n = static_cast<std::int32_t>(i & 0xFF);
+        surface.damage(n, n, 256, 256);
+        surface.commit();
+    }
+
+    pw::display display;
+    pw::registry registry;
+    pw::compositor compositor;
+    pw::surface surface;
+};
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t frames = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    {
+        paused_server server;
+        client_engine eng{server.client_fd()};
+        client c{eng};
+
+        std::size_t skipped = 0;
+        std::size_t max_pending = 0;
+        for (std::size_t i = 0; i < frames; ++i)
+        {
+            if (eng.would_block()) ++skipped;
+            else c.frame(i);
+            eng.flush();
+            max_pending = std::max(max_pending, eng.pending_output_size());
+        }
+
+        bench::report("respecting would_block: max pending", static_cast<double>(max_pending) / 1024, "KiB");
+        bench::report("high watermark", static_cast<double>(eng.get_output_watermarks().high_bytes) / 1024, "KiB");
+        bench::report("frames skipped", static_cast<double>(skipped), "");
+        bench::report("high watermark events", static_cast<double>(eng.high_watermark_count), "");
+
+        // the server resumes reading
+        while (eng.pending_output_size() != 0)
+        {
+            server.read_all();
+            eng.flush();
+        }
+        bench::report("drained events after resume", static_cast<double>(eng.drained_count), "");
+    }
+
+    {
+        paused_server server;
+        client_engine eng{server.client_fd()};
+        client c{eng};
+
+        for (std::size_t i = 0; i < frames; ++i)
+        {
+            c.frame(i);
+            eng.flush();
+        }
+        bench::report("ignoring would_block: pending", static_cast<double>(eng.pending_output_size()) / 1024, "KiB");
+    }
+}
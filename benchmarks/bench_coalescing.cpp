@@ -0,0 +1,85 @@
+// Event coalescing: a wl_pointer.motion flood with a wl_pointer.frame every 8 motions (i.e. a high-rate mouse),
+// dispatched with coalescing disabled and enabled (see `engine::set_event_coalescing`).
+// Reports the time per `process_input` call and the number of motion handler calls.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+
+namespace wlp = dd99::wayland::proto;
+namespace pw = wlp::wayland;
+namespace bench = dd99::wayland::bench;
+
+
+
+struct null_engine final : dd99::wayland::engine
+{
+    void on_output(std::span<const char>, std::span<int>) override { }
+};
+
+struct pointer final : pw::pointer
+{
+    using pw::pointer::pointer;
+
+    void on_motion(std::uint32_t, wlp::fixed_point x, wlp::fixed_point y) override { ++motion_count; sum += x.to_double() + y.to_double(); }
+    void on_frame() override { }
+
+    std::size_t motion_count = 0;
+    double sum = 0;
+};
+
+
+// 25000 frames of 8 motions
+std::vector<char> make_flood(std::uint32_t pointer_id)
+{
+    std::vector<char> stream;
+    for (std::uint32_t i = 0; i < 25000; ++i)
+    {
+        for (std::uint32_t j = 0; j < 8; ++j) bench::append_event(stream, pointer_id, 2, {i, (i + j) << 8, i << 8});   // motion
+        bench::append_event(stream, pointer_id, 5, {});                                                                 // frame
+    }
+    return stream;
+}
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 50;
+
+    null_engine eng;
+    pw::display display{eng};
+    eng.bind_display(display);
+    pw::registry registry{eng};
+    display.get_registry(registry);
+    pw::seat seat{eng};
+    registry.bind(1, "wl_seat", 7, seat);
+    pointer ptr{eng};
+    seat.get_pointer(ptr);
+
+    const auto stream = make_flood(ptr.get_id());
+
+    for (bool enabled : {false, true})
+    {
+        eng.set_event_coalescing(enabled);
+
+        // handler calls for one pass over the stream
+        ptr.motion_count = 0;
+        if (eng.process_input(stream) != stream.size()) throw std::logic_error{"partial stream"};
+        const auto motion_calls = ptr.motion_count;
+
+        auto ns = bench::ns_per_iteration(rounds, [&](std::size_t){
+            if (eng.process_input(stream) != stream.size()) throw std::logic_error{"partial stream"};
+        });
+
+        bench::report(enabled ? "coalescing enabled: process_input" : "coalescing disabled: process_input", ns / 1e6, "ms");
+        bench::report(enabled ? "coalescing enabled: motion handler calls" : "coalescing disabled: motion handler calls", static_cast<double>(motion_calls), "");
+    }
+}
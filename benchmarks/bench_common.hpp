@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+
+
+// helpers shared by the benchmarks (not installed, not part of the library)
+namespace dd99::wayland::bench
+{
+
+    // Nanoseconds per iteration of `body`: the best of `runs` runs of `iterations` calls.
+    template <class F>
+    double ns_per_iteration(std::size_t iterations, F && body, int runs = 5)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < iterations; ++i) body(i);
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed < best) best = elapsed;
+        }
+        return best / static_cast<double>(iterations);
+    }
+
+    // Appends an event to a stream of wire data: header, then 32-bit arguments,
+    // then an optional string argument (its length and null-terminated, padded content).
+    inline void append_event(std::vector<char> & stream, std::uint32_t object_id, std::uint16_t opcode,
+        std::initializer_list<std::uint32_t> args, std::string_view string = {})
+    {
+        const auto string_size = string.empty() ? 0 : sizeof(std::uint32_t) + ((string.size() + 1 + 3) & ~std::size_t{3});
+        const auto size = 2 * sizeof(std::uint32_t) + args.size() * sizeof(std::uint32_t) + string_size;
+
+        auto put = [&](std::uint32_t word)
+        {
+            const auto offset = stream.size();
+            stream.resize(offset + sizeof(word));
+            std::memcpy(stream.data() + offset, &word, sizeof(word));
+        };
+
+        put(object_id);
+        put(static_cast<std::uint32_t>(size << 16) | opcode);
+        for (auto arg : args) put(arg);
+        if (!string.empty())
+        {
+            put(static_cast<std::uint32_t>(string.size() + 1));
+            const auto offset = stream.size();
+            stream.resize(offset + string_size - sizeof(std::uint32_t), '\0');
+            std::memcpy(stream.data() + offset, string.data(), string.size());
+        }
+    }
+
+    // one line of results: `name: value unit`
+    inline void report(const char * name, double value, const char * unit)
+    {
+        std::printf("%-40s %12.2f %s\n", name, value, unit);
+    }
+
+}
@@ -0,0 +1,144 @@
+// Request marshaling: output calls and write syscalls per request.
+// Every request is handed to the transport as one complete message (one `on_output` call),
+// so an unbuffered transport needs one `send` per request.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+namespace bench = dd99::wayland::bench;
+
+
+
+// counts the calls and bytes handed to the transport
+struct counting_engine final : dd99::wayland::engine
+{
+    void on_output(std::span<const char> data, std::span<int>) override
+    {
+        ++calls;
+        bytes += data.size();
+    }
+
+    std::size_t calls = 0;
+    std::size_t bytes = 0;
+};
+
+
+// unbuffered transport: one `send` per `on_output` call, on one end of a socketpair
+struct socket_engine final : dd99::wayland::engine
+{
+    socket_engine()
+    {
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, m_fds) < 0)
+            throw std::system_error{errno, std::system_category(), "socketpair"};
+    }
+
+    socket_engine(const socket_engine &) = delete;
+    socket_engine & operator=(const socket_engine &) = delete;
+
+    ~socket_engine()
+    {
+        ::close(m_fds[0]);
+        ::close(m_fds[1]);
+    }
+
+    void on_output(std::span<const char> data, std::span<int>) override
+    {
+        ++syscalls;
+        if (::send(m_fds[0], data.data(), data.size(), MSG_NOSIGNAL) < 0)
+            throw std::system_error{errno, std::system_category(), "send"};
+    }
+
+    // the peer reads everything that was sent
+    void drain()
+    {
+        char buffer[64 * 1024];
+        while (::recv(m_fds[1], buffer, sizeof(buffer), MSG_DONTWAIT) > 0) { }
+    }
+
+    std::size_t syscalls = 0;
+
+private:
+    int m_fds[2] = {-1, -1};
+};
+
+
+
+// a surface and a data offer, to issue fixed-size and string-carrying requests
+template <class Engine>
+struct client
+{
+    explicit client(Engine & eng)
+        : display{eng}
+        , registry{eng}
+        , compositor{eng}
+        , surface{eng}
+        , offer{eng}
+    {
+        eng.bind_display(display);
+        display.get_registry(registry);
+        registry.bind(1, "wl_compositor", 4, compositor);
+        compositor.create_surface(surface);
+        eng.bind_server_object(offer, 0xFF000000, 3);
+    }
+
+    // one damage + commit pair, and one request with a string argument
+    void frame(std::size_t i)
+    {
+        const auto n = static_cast<std::int32_t>(i & 0xFF);
+        surface.damage(n, n, 256, 256);
+        surface.commit();
+        offer.accept(static_cast<std::uint32_t>(i), "text/plain;charset=utf-8");
+    }
+
+    static constexpr std::size_t requests_per_frame = 3;
+
+    pw::display display;
+    pw::registry registry;
+    pw::compositor compositor;
+    pw::surface surface;
+    pw::data_offer offer;
+};
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t frames = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const auto requests = static_cast<double>(frames * client<counting_engine>::requests_per_frame);
+
+    {
+        counting_engine eng;
+        client c{eng};
+        eng.calls = eng.bytes = 0;
+
+        const auto ns = bench::ns_per_iteration(frames, [&](std::size_t i){ c.frame(i); }, 1);
+        bench::report("on_output calls / request", static_cast<double>(eng.calls) / requests, "");
+        bench::report("bytes / request", static_cast<double>(eng.bytes) / requests, "B");
+        bench::report("marshaling (counting transport)", ns / client<counting_engine>::requests_per_frame, "ns/request");
+    }
+
+    {
+        socket_engine eng;
+        client c{eng};
+        eng.syscalls = 0;
+
+        const auto ns = bench::ns_per_iteration(frames, [&](std::size_t i){
+            c.frame(i);
+            if ((i & 0xF) == 0xF) eng.drain();
+        }, 1);
+        eng.drain();
+        bench::report("send syscalls / request", static_cast<double>(eng.syscalls) / requests, "");
+        bench::report("marshaling + send (socketpair)", ns / client<socket_engine>::requests_per_frame, "ns/request");
+    }
+}
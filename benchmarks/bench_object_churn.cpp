@@ -0,0 +1,94 @@
+// Object id churn: 1M short-lived callbacks (frame callbacks, roundtrips), created and deleted by the server.
+// Ids are allocated lowest free first, so the object table stays as large as the peak number of live objects
+// instead of growing with every id ever used. Reports the largest id used, the cycle time and the lookup time.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+namespace bench = dd99::wayland::bench;
+
+
+
+struct null_engine final : dd99::wayland::engine
+{
+    void on_output(std::span<const char>, std::span<int>) override { }
+};
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t cycles = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    constexpr std::size_t in_flight = 64;       // callbacks alive at the same time
+    constexpr std::size_t long_lived = 1000;    // objects that stay alive, allocated during the churn
+
+    null_engine eng;
+    pw::display display{eng};
+    eng.bind_display(display);
+    pw::registry registry{eng};
+    display.get_registry(registry);
+    pw::compositor compositor{eng};
+    registry.bind(1, "wl_compositor", 4, compositor);
+    pw::surface surface{eng};
+    compositor.create_surface(surface);
+
+    std::deque<dd99::wayland::object_id_t> callbacks;
+    std::vector<pw::region *> regions;
+    std::vector<char> events;
+    dd99::wayland::object_id_t max_id = 0;
+
+    // the server answers the oldest callback: `done`, then `delete_id`
+    auto retire_oldest = [&]
+    {
+        const auto id = callbacks.front();
+        callbacks.pop_front();
+        events.clear();
+        bench::append_event(events, id, 0, {0});        // wl_callback.done
+        bench::append_event(events, 1, 1, {id});        // wl_display.delete_id
+        eng.process_input(events);
+        eng.unbind_interface(id);                       // what a display's `on_delete_id` does
+    };
+
+    const auto cycle_ns = bench::ns_per_iteration(cycles, [&](std::size_t i)
+    {
+        auto & callback = eng.create<pw::callback_handled>();
+        surface.frame(callback);
+        callbacks.push_back(callback.get_id());
+        max_id = std::max(max_id, callback.get_id());
+
+        if (i % (cycles / long_lived) == 0)
+        {
+            auto & region = eng.create<pw::region>();
+            compositor.create_region(region);
+            regions.push_back(&region);
+            max_id = std::max(max_id, region.get_id());
+        }
+
+        if (callbacks.size() == in_flight) retire_oldest();
+    }, 1);
+    while (!callbacks.empty()) retire_oldest();
+
+    // lookups of every id in range (live or not). The result is used, so the lookups are not optimized away
+    std::size_t found = 0;
+    const auto lookup_ns = bench::ns_per_iteration(100, [&](std::size_t)
+    {
+        for (dd99::wayland::object_id_t id = 1; id <= max_id; ++id) found += (eng.get_interface(id) != nullptr);
+    }) / max_id;
+
+    bench::report("cycles (create + delete)", static_cast<double>(cycles), "");
+    bench::report("live objects at the end", static_cast<double>(regions.size() + 5), "");
+    bench::report("largest object id", static_cast<double>(max_id), "");
+    bench::report("create + delete cycle", cycle_ns, "ns");
+    bench::report("get_interface", lookup_ns, "ns/lookup");
+    return (found != 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,97 @@
+// Event decoding: throughput of a wl_pointer.motion / wl_pointer.axis flood (i.e. a high-rate mouse or touchpad).
+// Every event is decoded and dispatched (coalescing is disabled), to a derived class and to a handled class.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+
+namespace wlp = dd99::wayland::proto;
+namespace pw = wlp::wayland;
+namespace bench = dd99::wayland::bench;
+
+
+
+struct null_engine final : dd99::wayland::engine
+{
+    void on_output(std::span<const char>, std::span<int>) override { }
+};
+
+struct pointer final : pw::pointer
+{
+    using pw::pointer::pointer;
+
+    void on_motion(std::uint32_t, wlp::fixed_point x, wlp::fixed_point y) override { sum += x.to_double() + y.to_double(); }
+    void on_axis(std::uint32_t, pw::pointer::axis, wlp::fixed_point value) override { sum += value.to_double(); }
+    void on_frame() override { }
+
+    double sum = 0;
+};
+
+
+// events/second to dispatch `stream` (`event_count` events)
+double events_per_second(null_engine & eng, const std::vector<char> & stream, std::size_t event_count, std::size_t rounds)
+{
+    auto ns = bench::ns_per_iteration(rounds, [&](std::size_t){
+        if (eng.process_input(stream) != stream.size()) throw std::logic_error{"partial stream"};
+    });
+    return static_cast<double>(event_count) / ns * 1e9;
+}
+
+// 1024 frames of `motion, motion, axis, axis, frame`
+std::vector<char> make_flood(std::uint32_t pointer_id, std::size_t & event_count)
+{
+    std::vector<char> stream;
+    for (std::uint32_t i = 0; i < 1024; ++i)
+    {
+        bench::append_event(stream, pointer_id, 2, {i, i << 8, i << 9});          // motion
+        bench::append_event(stream, pointer_id, 2, {i, (i + 1) << 8, i << 9});
+        bench::append_event(stream, pointer_id, 4, {i, 0, 10 << 8});             // axis (vertical)
+        bench::append_event(stream, pointer_id, 4, {i, 1, 3 << 8});              // axis (horizontal)
+        bench::append_event(stream, pointer_id, 5, {});                           // frame
+        event_count += 5;
+    }
+    return stream;
+}
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 2000;
+
+    null_engine eng;
+    pw::display display{eng};
+    eng.bind_display(display);
+    pw::registry registry{eng};
+    display.get_registry(registry);
+    pw::seat seat{eng};
+    registry.bind(1, "wl_seat", 7, seat);
+
+    {
+        pointer ptr{eng};
+        seat.get_pointer(ptr);
+
+        std::size_t event_count = 0;
+        const auto stream = make_flood(ptr.get_id(), event_count);
+        bench::report("derived class", events_per_second(eng, stream, event_count, rounds) / 1e6, "M events/s");
+    }
+
+    {
+        pw::pointer_handled ptr{eng};
+        seat.get_pointer(ptr);
+        double sum = 0;
+        ptr.handlers.on_motion = [&](std::uint32_t, wlp::fixed_point x, wlp::fixed_point y){ sum += x.to_double() + y.to_double(); };
+        ptr.handlers.on_axis = [&](std::uint32_t, pw::pointer::axis, wlp::fixed_point value){ sum += value.to_double(); };
+
+        std::size_t event_count = 0;
+        const auto stream = make_flood(ptr.get_id(), event_count);
+        bench::report("handled class", events_per_second(eng, stream, event_count, rounds) / 1e6, "M events/s");
+    }
+}
@@ -0,0 +1,94 @@
+// Event dispatch over a large object table: bursts of wl_keyboard.key events spread randomly over many objects.
+// With a working set larger than the last level cache, dispatch is bound by the slot and object lookups,
+// which `process_input` prefetches a few messages ahead (from its pre-scan of message boundaries).
+// Reports the dispatch rate for a small and a large set of objects, and the rate of `engine::count_messages`.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+namespace bench = dd99::wayland::bench;
+
+
+
+struct null_engine final : dd99::wayland::engine
+{
+    void on_output(std::span<const char>, std::span<int>) override { }
+};
+
+struct keyboard final : pw::keyboard
+{
+    using pw::keyboard::keyboard;
+
+    void on_key(std::uint32_t, std::uint32_t, std::uint32_t key, std::uint32_t) override { sum += key; }
+
+    std::uint64_t sum = 0;
+};
+
+
+// events/second to dispatch `event_count` key events spread randomly over `object_count` keyboards
+double events_per_second(std::size_t object_count, std::size_t event_count, std::size_t rounds)
+{
+    null_engine eng;
+    pw::display display{eng};
+    eng.bind_display(display);
+    pw::registry registry{eng};
+    display.get_registry(registry);
+    pw::seat seat{eng};
+    registry.bind(1, "wl_seat", 1, seat);
+
+    // allocated one by one: objects are scattered in memory, as in an application
+    std::vector<std::unique_ptr<keyboard>> keyboards;
+    keyboards.reserve(object_count);
+    for (std::size_t i = 0; i < object_count; ++i)
+    {
+        keyboards.push_back(std::make_unique<keyboard>(eng));
+        seat.get_keyboard(*keyboards.back());
+    }
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<std::size_t> pick{0, object_count - 1};
+    std::vector<char> stream;
+    for (std::uint32_t i = 0; i < event_count; ++i)
+        bench::append_event(stream, keyboards[pick(rng)]->get_id(), 3, {i, i, i & 0xff, 1});
+
+    auto ns = bench::ns_per_iteration(rounds, [&](std::size_t){
+        if (eng.process_input(stream) != stream.size()) throw std::logic_error{"partial stream"};
+    }, 3);
+    return static_cast<double>(event_count) / ns * 1e9;
+}
+
+// messages/second counted by `engine::count_messages`
+double counted_per_second(std::size_t event_count, std::size_t rounds)
+{
+    std::vector<char> stream;
+    for (std::uint32_t i = 0; i < event_count; ++i)
+        bench::append_event(stream, 3, 3, {i, i, i & 0xff, 1});
+
+    std::size_t counted = 0;
+    auto ns = bench::ns_per_iteration(rounds, [&](std::size_t){ counted += dd99::wayland::engine::count_messages(stream); });
+    if (counted != event_count * rounds * 5) throw std::logic_error{"miscounted stream"};
+    return static_cast<double>(event_count) / ns * 1e9;
+}
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10;
+    constexpr std::size_t event_count = 400000;
+
+    bench::report("4k objects (cache resident)", events_per_second(4096, event_count, rounds) / 1e6, "M events/s");
+    bench::report("1M objects (larger than the LLC)", events_per_second(1 << 20, event_count, rounds) / 1e6, "M events/s");
+    bench::report("count_messages", counted_per_second(event_count, rounds) / 1e6, "M messages/s");
+}
@@ -0,0 +1,107 @@
+// Input validation policies: cost of `input_validation::checked` over `input_validation::trusted`.
+// A stream of typical input events (pointer motion, button, axis and frame, keyboard keys, data offers with a string)
+// is dispatched to objects with trivial handlers, with each policy.
+
+#include "bench_common.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+
+namespace wlp = dd99::wayland::proto;
+namespace pw = wlp::wayland;
+namespace bench = dd99::wayland::bench;
+using dd99::wayland::input_validation;
+
+
+
+struct null_engine final : dd99::wayland::engine
+{
+    void on_output(std::span<const char>, std::span<int>) override { }
+};
+
+struct pointer final : pw::pointer
+{
+    using pw::pointer::pointer;
+
+    void on_motion(std::uint32_t time, wlp::fixed_point, wlp::fixed_point) override { events += time & 1; }
+    void on_button(std::uint32_t, std::uint32_t time, std::uint32_t, pw::pointer::button_state) override { events += time & 1; }
+    void on_axis(std::uint32_t time, pw::pointer::axis, wlp::fixed_point) override { events += time & 1; }
+    void on_frame() override { ++events; }
+
+    std::size_t events = 0;
+};
+
+struct keyboard final : pw::keyboard
+{
+    using pw::keyboard::keyboard;
+
+    void on_key(std::uint32_t, std::uint32_t time, std::uint32_t, std::uint32_t) override { events += time & 1; }
+
+    std::size_t events = 0;
+};
+
+struct data_offer final : pw::data_offer
+{
+    using pw::data_offer::data_offer;
+
+    void on_offer(wlp::zview mime_type) override { events += mime_type.size() & 1; }
+
+    std::size_t events = 0;
+};
+
+
+
+int main(int argc, char ** argv)
+{
+    const std::size_t rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 2000;
+
+    null_engine eng;
+    pw::display display{eng};
+    eng.bind_display(display);
+    pw::registry registry{eng};
+    display.get_registry(registry);
+    pw::seat seat{eng};
+    registry.bind(1, "wl_seat", 7, seat);
+    pointer ptr{eng};
+    seat.get_pointer(ptr);
+    keyboard kbd{eng};
+    seat.get_keyboard(kbd);
+    data_offer offer{eng};
+    eng.bind_server_object(offer, 0xFF000000, 3);
+
+    // 1024 frames of input, 7 events each
+    std::vector<char> stream;
+    std::size_t event_count = 0;
+    for (std::uint32_t i = 0; i < 1024; ++i)
+    {
+        bench::append_event(stream, ptr.get_id(), 2, {i, i << 8, i << 9});        // motion
+        bench::append_event(stream, ptr.get_id(), 2, {i, i << 8, i << 9});
+        bench::append_event(stream, ptr.get_id(), 4, {i, 0, 10 << 8});           // axis
+        bench::append_event(stream, ptr.get_id(), 3, {i, i, 272, i & 1});         // button
+        bench::append_event(stream, ptr.get_id(), 5, {});                         // frame
+        bench::append_event(stream, kbd.get_id(), 2, {i, i, 30, i & 1});          // key
+        bench::append_event(stream, offer.get_id(), 0, {}, "text/plain;charset=utf-8");
+        event_count += 7;
+    }
+
+    auto trusted = bench::ns_per_iteration(rounds, [&](std::size_t){
+        if (eng.process_input<input_validation::trusted>(stream) != stream.size()) throw std::logic_error{"partial stream"};
+    });
+    auto checked = bench::ns_per_iteration(rounds, [&](std::size_t){
+        if (eng.process_input<input_validation::checked>(stream) != stream.size()) throw std::logic_error{"partial stream"};
+    });
+
+    const auto events = static_cast<double>(event_count);
+    const auto bytes = static_cast<double>(stream.size());
+    bench::report("trusted", trusted / events, "ns/event");
+    bench::report("checked", checked / events, "ns/event");
+    bench::report("trusted throughput", bytes / trusted * 1e3, "MB/s");
+    bench::report("checked throughput", bytes / checked * 1e3, "MB/s");
+    bench::report("checked overhead", (checked / trusted - 1) * 100, "%");
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+
+#include <dd99/wayland/engine.hpp>
+#include <dd99/wayland/inplace_function.hpp>
+
+#include <coroutine>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+
+namespace dd99::wayland
+{
+
+    // Awaits the next call of an event handler (a member of `handlers` of a handled class, i.e. `pointer_handled`).
+    // The handler is set while the coroutine waits, and reset when the event arrives.
+    // The coroutine is resumed inside the dispatch of the event (by `process_input`, or by the thread dispatching the event queue
+    // of the object), so it works with any executor: to continue somewhere else, await that executor afterwards.
+    // Arguments that refer to the message (strings, arrays) are valid until the coroutine suspends again.
+    // The object must outlive the wait.
+    // Usage:
+    //  auto [serial, surface, x, y] = co_await next_event(pointer.handlers.on_enter);
+    template <class ... Args>
+    class event_awaitable
+    {
+    public:
+        using handler_t = inplace_function<void(Args...)>;
+
+        explicit event_awaitable(handler_t & handler)
+            : m_handler{handler}
+        { }
+
+        // the handler refers to this object
+        event_awaitable(const event_awaitable &) = delete;
+        event_awaitable & operator=(const event_awaitable &) = delete;
+
+        // a coroutine destroyed while waiting leaves no dangling handler
+        ~event_awaitable()
+        {
+            if (m_continuation && !m_result) m_handler = nullptr;
+        }
+
+
+    public: // awaitable interface
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> continuation)
+        {
+            m_continuation = continuation;
+            m_handler = [this](Args ... args)
+            {
+                // resetting the handler does not touch its (trivially copyable) state, but `this` is read first anyway
+                auto & self = *this;
+                self.m_handler = nullptr;
+                self.m_result.emplace(std::forward<Args>(args)...);
+                self.m_continuation.resume();
+            };
+        }
+
+        // the arguments of the event: nothing, its argument, or a tuple of its arguments
+        auto await_resume()
+        {
+            if constexpr (sizeof...(Args) == 1) return std::get<0>(std::move(*m_result));
+            else if constexpr (sizeof...(Args) > 1) return std::move(*m_result);
+        }
+
+
+    private:
+        handler_t & m_handler;
+        std::coroutine_handle<> m_continuation{};
+        std::optional<std::tuple<std::decay_t<Args>...>> m_result{};
+    };
+
+    template <class ... Args, std::size_t Capacity>
+    event_awaitable<Args...> next_event(inplace_function<void(Args...), Capacity> & handler)
+    {
+        return event_awaitable<Args...>{handler};
+    }
+
+
+    // Sends a request that creates a callback object (`wl_display.sync`, `wl_surface.frame`) and awaits its `done` event.
+    // The callback object (a handled `wl_callback`) is embedded in the awaitable: awaited as a temporary, it lives
+    // in the coroutine frame (no separate allocation). `co_await` returns the data of the event.
+    // Awaitables are made by the generated interfaces:
+    //  co_await display.roundtrip();
+    //  auto time = co_await surface.next_frame();
+    template <class Callback>
+    class callback_awaitable
+    {
+    public:
+        using request_t = inplace_function<void(Callback &)>;
+
+        callback_awaitable(engine & eng, request_t request)
+            : m_callback{eng}
+            , m_request{std::move(request)}
+        { }
+
+        // the callback object is bound by the request
+        callback_awaitable(const callback_awaitable &) = delete;
+        callback_awaitable & operator=(const callback_awaitable &) = delete;
+
+
+    public: // awaitable interface
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> continuation)
+        {
+            // the handler is set before the request is sent: the event may be dispatched by another thread (see `event_queue`)
+            m_done.await_suspend(continuation);
+            m_request(m_callback);
+        }
+
+        std::uint32_t await_resume() { return m_done.await_resume(); }
+
+
+    private:
+        Callback m_callback;
+        request_t m_request;
+        event_awaitable<std::uint32_t> m_done{m_callback.handlers.on_done};
+    };
+
+
+    // Coroutine type for coroutines nobody waits for (i.e. startup code awaiting roundtrips).
+    // It starts immediately, and frees itself when it completes.
+    // An exception escaping the coroutine propagates to whoever resumed it (i.e. out of `process_input`),
+    // and the coroutine is not freed.
+    struct detached_task
+    {
+        struct promise_type
+        {
+            detached_task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept { }
+            void unhandled_exception() { throw; }
+        };
+    };
+
+}
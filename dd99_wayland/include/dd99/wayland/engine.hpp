@@ -7,8 +7,13 @@
 #include <cassert>
 #include <concepts>
 #include <cstddef>
+#include <exception>
 #include <memory>
+#include <new>
 #include <span>
+#include <stdexcept>
+#include <sys/uio.h>
+#include <utility>
 
 
 
@@ -16,6 +21,7 @@ namespace dd99::wayland
 {
 
     // fw-declarations
+    struct event_queue;
     namespace proto { struct interface; }
     namespace proto::wayland { struct display; }
 
@@ -23,6 +29,65 @@ namespace dd99::wayland
     namespace detail { struct engine_data; }
 
 
+    // Counters kept by the engine's output buffer.
+    // A "flush" is one call to `engine::flush()` that hands data to `on_flush`
+    // (one or more calls to `on_flush`, see `engine::set_max_fds_per_flush`).
+    struct output_statistics
+    {
+        std::size_t flush_count = 0;
+        std::size_t total_bytes = 0;            // bytes accepted by `on_flush`
+        std::size_t total_messages = 0;         // messages handed to `on_flush`
+
+        std::size_t last_flush_bytes = 0;
+        std::size_t last_flush_messages = 0;
+        std::size_t max_flush_bytes = 0;
+        std::size_t max_flush_messages = 0;
+    };
+
+
+
+    // Thresholds on pending output (see `engine::set_output_watermarks`)
+    struct output_watermarks
+    {
+        std::size_t high_bytes = 256 * 1024;
+        std::size_t low_bytes = 64 * 1024;
+        std::size_t high_fds = 256;
+        std::size_t low_fds = 64;
+    };
+
+
+
+    // How much `engine::process_input` trusts its input (selected at compile time)
+    enum class input_validation
+    {
+        // The peer is trusted to send well-formed messages (i.e. a client connected to its compositor).
+        // Messages are only checked with assertions, except for the object id:
+        // an event for an unknown object (an id never bound, or already deleted) throws `protocol_error`,
+        // because the file descriptors it carries are not known (events of destroyed objects are still discarded).
+        trusted,
+
+        // Every message is checked before it is dispatched: header, size, object id, opcode,
+        // and that every argument (including string and array lengths) fits inside the message.
+        // A malformed message throws `protocol_error`.
+        checked,
+    };
+
+
+    // Malformed message received (see `input_validation::checked`)
+    // The stream can not be resynchronized after this error: the connection should be closed.
+    struct protocol_error : std::runtime_error
+    {
+        protocol_error(const char * what, object_id_t object_id_, opcode_t opcode_)
+            : std::runtime_error{what}
+            , object_id{object_id_}
+            , opcode{opcode_}
+        { }
+
+        object_id_t object_id;
+        opcode_t opcode;
+    };
+
+
 
     // The engine stores all created interfaces and assigns an object-id to new interfaces
     // Interface creation/destruction and binding can only be done by the engine
@@ -35,7 +100,8 @@ namespace dd99::wayland
     protected:
         // virtual destruction not allowed
         // you must destruct the engine instance through a properly typed instance object destructor
-        ~engine() = default;
+        // objects made by `create` that are still alive are destroyed here
+        ~engine();
 
 
     public:
@@ -73,6 +139,17 @@ namespace dd99::wayland
             assert(new_id == 1);
         }
 
+        // Objects created by the server (`new_id` event arguments, i.e. `data_device.data_offer`) get their id from the event.
+        // Bind an interface instance to that id (usually from the event handler) to receive the events of the new object.
+        // It must be bound before its first event is processed: events for unknown ids are a `protocol_error`.
+        // `version` is the version of the object that received the event.
+        // Server ids are stored in a dense table (as client ids are), so their events are dispatched with one indexed lookup.
+        template <class T>
+        void bind_server_object(T & interface_instance, object_id_t id, version_t version)
+        {
+            bind_interface(reinterpret_cast<proto::interface &>(interface_instance), version, id);
+        }
+
 
     public: // I/O API
 
@@ -84,17 +161,215 @@ namespace dd99::wayland
         // The user is expected to buffer received data. This handles the possibility
         // of partial messages that must be kept until they are processed.
         // The return value can be used to indicate whether there is a partial message in buffer.
-        // This function takes `iovec` (scatter/gather style) input to allow efficient implementations using ringbuffers.
+        // 
+        // About validation:
+        // Input is trusted by default. Use `process_input<input_validation::checked>(...)` for input from an untrusted peer.
+        // 
+        // About bursts:
+        // Message boundaries are pre-scanned (up to 64 messages at a time) before dispatching,
+        // and the target objects of the next messages are prefetched while a message is dispatched.
         // 
         // @RETURN: bytes consumed
-        // std::size_t process_input(iovec * data, std::size_t iovec_count);
+        template <input_validation Validation = input_validation::trusted>
         std::size_t process_input(std::span<const char> data);
 
+        // number of complete messages at the start of `data` (a cheap "messages pending" count, using the same pre-scan)
+        static std::size_t count_messages(std::span<const char> data);
+
+        // Scatter/gather variant, to allow efficient implementations using ringbuffers (i.e. the two halves of a wrapped ring).
+        // The segments are a single stream of data. Complete messages are dispatched in place.
+        // A message that straddles two (or more) segments is copied to an internal bounce buffer and dispatched from there.
+        // A trailing partial message is not consumed, so the caller never needs to compact its buffer.
+        // Neither is anything from a message whose file descriptors have not been given to the engine yet.
+        // 
+        // @RETURN: bytes consumed (counted across segments)
+        template <input_validation Validation = input_validation::trusted>
+        std::size_t process_input(std::span<const ::iovec> data);
+
+        // File descriptors received from the server (SCM_RIGHTS ancillary data) must be given to the engine,
+        // in the order they were received, no later than the data that arrived with them.
+        // They are passed to event handlers as `fd` arguments; a handler owns the file descriptors it receives
+        // (the default handlers close them).
+        // A message is not dispatched until the file descriptors it carries have been given to the engine.
+        // The engine owns queued file descriptors: those of events for destroyed objects are closed,
+        // and so are the ones still queued when the engine is destroyed.
+        void push_input_fds(std::span<const int> fds);
+
+        // `push_input_fds(fds)` followed by `process_input(data)`
+        template <input_validation Validation = input_validation::trusted>
+        std::size_t process_input(std::span<const char> data, std::span<const int> fds);
+
+
+    public: // Event queues
+
+        // Assign an object to an event queue (see `event_queue`), or back to the default queue (nullptr).
+        // The events of the default queue are dispatched by `process_input`.
+        // Events already queued stay in the queue they were queued to.
+        template <class T>
+        void set_queue(T & interface_instance, event_queue * queue)
+        {
+            set_interface_queue(reinterpret_cast<proto::interface &>(interface_instance), queue);
+        }
+
+
+    public: // Event masks
+
+        // Events of an object that are not dispatched (or queued): `process_input` skips them after reading their header
+        // (file descriptors they carry are closed). The object must be bound. Objects are bound with an empty mask.
+        // Usage:
+        //  eng.set_ignored_events(pointer, event_mask(pointer::events::axis_discrete, pointer::events::axis_value120));
+        template <class T>
+        void set_ignored_events(T & interface_instance, event_mask_t mask)
+        {
+            set_interface_ignored_events(reinterpret_cast<proto::interface &>(interface_instance), mask);
+        }
+
+
+    public: // Pooled objects
+
+        // Makes an interface object owned by the engine: `T(engine, args...)`, in memory taken from a slab pool
+        // (one pool per object size, so short-lived objects like `wl_callback` or `wl_region` do not go through the heap).
+        // The object is destroyed, and its memory reused, when its destructor request is sent (i.e. `region.destroy()`),
+        // or when its id is deleted by the server (`unbind_interface`, called from `wl_display.delete_id`), whichever comes first.
+        // Do not use it afterwards. Objects still alive are destroyed with the engine.
+        // The interface must be the first base of `T`.
+        // Usage:
+        //  auto & callback = eng.create<pw::callback_handled>();
+        //  callback.handlers.on_done = ...;
+        //  surface.frame(callback);
+        template <class T, class ... Args>
+        T & create(Args && ... args)
+        {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned objects can not be pooled");
+            void * memory = allocate_pooled(sizeof(T));
+
+            T * object;
+            try { object = new (memory) T(*this, std::forward<Args>(args)...); }
+            catch (...) { deallocate_pooled(memory); throw; }
+
+            assert(static_cast<void *>(static_cast<proto::interface *>(object)) == memory);
+            return *object;
+        }
+
+
+    public: // Event coalescing
+
+        // Opt-in stage of `process_input` for high-rate input events (disabled by default).
+        // Repeated events of an object are held back and merged until an event that is not coalesced arrives
+        // (i.e. `wl_pointer.frame`, `wl_pointer.button`, or any event of another interface), or until `process_input` returns.
+        // The held events are then dispatched in their original order: handlers get one call per pointer (or touch point) per frame.
+        //  - wl_pointer.motion and wl_touch.motion (per touch id): only the latest one is dispatched
+        //  - wl_pointer.axis, axis_discrete and axis_value120 (per axis): the deltas are summed
+        // Rules come from the interfaces (see `proto::interface_descriptor::event_coalescing_rules`). Events of objects assigned to an event queue are not coalesced.
+        void set_event_coalescing(bool enabled);
+        bool get_event_coalescing() const;
+
+        // number of events dropped (merged into a later event) by the coalescing stage
+        std::size_t get_coalesced_event_count() const;
+        void reset_coalesced_event_count();
+
+
+    public: // Request batching
+
+        // Groups the requests issued while it is alive: they are marshalled into the output buffer
+        // and handed to the transport once, when the outermost guard is destroyed (a single `flush()`).
+        // Guards can be nested. Output buffering does not need to be enabled, and automatic flushing is suspended inside the batch.
+        // 
+        // Usage:
+        //  {
+        //      engine::batch guard{eng};
+        //      surface.attach(buffer, 0, 0);
+        //      surface.damage_buffer(0, 0, w, h);
+        //      surface.frame(callback);
+        //      surface.commit();
+        //  } // one write
+        // 
+        // Flushing may report transport errors, so the destructor can throw. A guard destroyed by stack unwinding
+        // does not flush (throwing then would terminate): the batched output is left pending,
+        // and goes out first with the next flush (or the next request).
+        struct batch
+        {
+            explicit batch(engine & eng)
+                : m_engine{eng}
+                , m_uncaught_exceptions{std::uncaught_exceptions()}
+            {
+                m_engine.begin_batch();
+            }
+
+            ~batch() noexcept(false)
+            {
+                m_engine.end_batch(std::uncaught_exceptions() <= m_uncaught_exceptions);
+            }
+
+            batch(const batch &) = delete;
+            batch & operator=(const batch &) = delete;
+
+        private:
+            engine & m_engine;
+            int m_uncaught_exceptions;
+        };
+
+        // same as `batch`, for scopes that do not fit RAII. Calls must be balanced
+        // With `flush_output == false` the outermost `end_batch` leaves the batched output pending.
+        void begin_batch();
+        void end_batch(bool flush_output = true);
+
+
+    public: // Output buffering API
+
+        static constexpr std::size_t default_flush_threshold = 4096;
+
+        // Output buffering is disabled by default: every message is passed to `on_output` as soon as it is marshalled.
+        // 
+        // When enabled, marshalled messages are collected in an engine-owned buffer and handed to `on_flush` all at once.
+        // This happens when `flush()` is called, or automatically when `flush_threshold` or more bytes are pending.
+        // A flush threshold of 0 disables automatic flushing.
+        // 
+        // Pending data is not flushed by the engine destructor. Call `flush()` before destroying the engine.
+        void enable_output_buffering(std::size_t flush_threshold = default_flush_threshold);
+
+        // flushes pending data and goes back to unbuffered output
+        void disable_output_buffering();
+        bool is_output_buffering_enabled() const;
+
+        // Hands all pending output to `on_flush`.
+        // @RETURN: bytes accepted by `on_flush`
+        std::size_t flush();
+
+        // bytes marshalled but not yet accepted by `on_flush`
+        std::size_t pending_output_size() const;
+
+        // file descriptors queued but not yet accepted by `on_flush`
+        std::size_t pending_output_fds() const;
+
+        // File descriptors queued in the output buffer are handed to `on_flush` in chunks of at most `max_fds`.
+        // Each chunk carries the data up to (and including) the message with its last file descriptor,
+        // so no message is sent before its file descriptors. One `on_flush` call maps onto one `sendmsg`.
+        // Default: `max_fds_per_message` (see scm_rights.hpp).
+        void set_max_fds_per_flush(std::size_t max_fds);
+
+        const output_statistics & get_output_statistics() const;
+        void reset_output_statistics();
+
+        // Backpressure signalling for buffered output.
+        // When pending output reaches the high watermark (bytes or file descriptors), `on_output_high_watermark` is called
+        // and `would_block()` becomes true. When a flush brings it back to the low watermark (both bytes and file descriptors),
+        // `on_output_drained` is called and `would_block()` becomes false again.
+        // A high watermark of 0 disables that check.
+        void set_output_watermarks(const output_watermarks & watermarks);
+        const output_watermarks & get_output_watermarks() const;
+
+        // true while pending output is above the high watermark (the receiver is not keeping up)
+        // Callers can use it to skip work that would only queue more output (i.e. rendering a frame).
+        bool would_block() const;
+
 
     public: // I/O Events that MUST be implemented by derived clases
         
         // When there is data to be sent to the wayland server, this callback gets called.
         // Calling this function is always the result of interacting with wayland objects in this library.
+        // Without output buffering, each call carries exactly one complete message.
+        // Flushed output handed over by the default `on_flush` (see `enable_output_buffering` and `batch`) carries complete messages.
         // 
         // Signature:
         //  `data` is just binary data to be sent to the server
@@ -102,18 +377,99 @@ namespace dd99::wayland
         virtual void on_output(std::span<const char> data, std::span<int> ancillary_output_fd_collection) = 0;
 
 
+    public: // I/O Events that MAY be implemented by derived clases
+
+        // Called when buffered output is flushed (see `enable_output_buffering`).
+        // `data` holds any number of complete messages, `fds` are the file descriptors they carry (see `set_max_fds_per_flush`).
+        // This maps directly onto a single `writev`/`sendmsg` call.
+        // 
+        // @RETURN: the number of bytes accepted. Bytes not accepted stay in the buffer for the next flush.
+        //          File descriptors are considered sent once any byte is accepted.
+        // 
+        // The default implementation forwards each `iovec` to `on_output` and accepts everything.
+        virtual std::size_t on_flush(std::span<const ::iovec> data, std::span<int> fds);
+
+        // Scatter/gather variant of `on_output`, used for messages that carry large strings or arrays.
+        // `data` is one complete message: header and small arguments point to a scratch area, large payloads point to the caller's memory.
+        // The referenced memory is only valid during this call. This maps directly onto a single `writev`/`sendmsg` call.
+        // 
+        // The default implementation gathers the message into a contiguous buffer and calls `on_output`.
+        // This callback is not used while output buffering is enabled (the message is copied to the output buffer instead).
+        virtual void on_output_iov(std::span<const ::iovec> data, std::span<int> fds);
+
+        // Called once when pending output reaches the high watermark (see `set_output_watermarks`).
+        // This happens while a message is being queued, so it may be called from inside any request.
+        // The default implementation does nothing.
+        virtual void on_output_high_watermark() { }
+
+        // Called once when a flush brings pending output back to the low watermark, after `on_output_high_watermark`.
+        // The default implementation does nothing.
+        virtual void on_output_drained() { }
+
+
     public: // internal functions used by protocol interfaces. Do not use directly. TODO: move to accessor for interfaces
 
+        // Entry point for every marshalled message.
+        // Forwards to `on_output`, or appends to the output buffer when buffering is enabled.
+        void write_message(std::span<const char> data, std::span<int> fds);
+        void write_message(std::span<const ::iovec> data, std::span<int> fds);
+
         object_id_t bind_interface(proto::interface &, version_t version);
 
+        // bind to an id allocated by the server
+        void bind_interface(proto::interface &, version_t version, object_id_t id);
+
+        // bind a new object created by a request of `parent` (it inherits the event queue of its parent)
+        object_id_t bind_interface(proto::interface &, version_t version, const proto::interface & parent);
+
+        void set_interface_queue(proto::interface &, event_queue * queue);
+        void set_interface_ignored_events(proto::interface &, event_mask_t mask);
+
+        // a queue is created: the objects destroyed from now on are forgotten by its queued events
+        void add_queue(event_queue & queue);
+
+        // the queue is being destroyed: its objects go back to the default queue
+        void remove_queue(event_queue & queue);
+
         void unbind_interface(object_id_t id);
 
+        // Called after a destructor request: objects made by `create` are destroyed (nothing happens to other objects).
+        // This must be the last use of the object.
+        void release_interface(proto::interface &);
+
+        // Called when an interface instance is destroyed.
+        // Its object id stays reserved until the server deletes the object (`unbind_interface`) or reuses a server id.
+        void detach_interface(proto::interface &);
+
+        // next received file descriptor (used by generated code to dispatch `fd` arguments)
+        // while an event queue dispatches, the file descriptors come from that queue
+        int take_input_fd();
+
+        // object of the next `object` argument (used by generated code to dispatch `object` arguments)
+        // while an event queue dispatches, the objects come from that queue (they were looked up when the event was queued)
+        proto::interface * take_object_argument(object_id_t id);
+        template <class T> T * take_object_argument(object_id_t id) { return reinterpret_cast<T *>(take_object_argument(id)); }
+
         // template <class T, class ... Args>
         // std::pair<object_id_t, T &> allocate_interface(Args && ... args);
 
         // void free_interface(proto::interface &);
 
 
+    private:
+        // watermark state transitions (see `set_output_watermarks`)
+        void check_output_high_watermark();
+        void check_output_drained();
+
+        // dispatches the events held back by the coalescing stage of `process_input`, in order
+        void flush_coalesced_events();
+
+        // memory of the objects made by `create`
+        void * allocate_pooled(std::size_t size);
+        void deallocate_pooled(void * memory);
+        void destroy_pooled(proto::interface &);
+
+
     private: // auxiliary type definitions
 
         // obscure data type used for dependency decoupling
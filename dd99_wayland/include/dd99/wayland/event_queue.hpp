@@ -0,0 +1,115 @@
+#pragma once
+
+
+#include <dd99/wayland/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+
+
+namespace dd99::wayland
+{
+
+    // fw-declarations
+    struct engine;
+    namespace proto
+    {
+        struct interface;
+        using event_dispatch_fn = void (*)(interface & object, std::span<const char> data);
+    }
+    namespace detail { struct fd_ring; }
+
+
+    // Queue of events for a group of objects (the equivalent of libwayland's `wl_event_queue`).
+    //
+    // Objects are assigned to a queue with `engine::set_queue`. New objects created by a request
+    // of a queued object (i.e. the callback of `surface.frame`) are assigned to the same queue.
+    // `process_input` does not dispatch the events of queued objects: only their messages are copied to the queue
+    // (with their file descriptors). They are dispatched when the thread that owns the queue calls `dispatch_pending()`.
+    //
+    // Threading:
+    // Queued events are self-contained: their file descriptors are taken from the engine when they are queued, and the objects
+    // of their `object` arguments are looked up then (an object destroyed before the event is dispatched is passed as nullptr).
+    // Decoding them does not read the engine, so `dispatch_pending()` only takes the lock of the queue:
+    // another thread can dispatch it at its own pace (i.e. a render thread dispatching its frame callbacks)
+    // while `process_input` runs. `size()` and `empty()` need no lock either.
+    // Handlers that use the engine (requests, creating or destroying objects) are not synchronized with its other users
+    // by the library (see wayland_client.hpp).
+    // A queued object must be destroyed by the thread that dispatches its queue (or while the queue is not dispatched).
+    // A queue is created and destroyed like an object: it registers with the engine.
+    //
+    // If an event handler throws, the exception propagates out of `dispatch_pending()`. The events that were not dispatched
+    // yet are dropped, and their file descriptors closed.
+    //
+    // The queue must be destroyed before its engine. Objects still assigned to it go back to the default queue
+    // and the file descriptors of events that were not dispatched are closed.
+    struct event_queue
+    {
+        explicit event_queue(engine & eng);
+        ~event_queue();
+
+        event_queue(const event_queue &) = delete;
+        event_queue(event_queue &&) = delete; // objects keep a pointer to their queue
+
+
+    public: // API
+
+        // Dispatches the events queued so far, in the order they were received.
+        // @RETURN: number of events dispatched
+        std::size_t dispatch_pending();
+
+        // number of events waiting to be dispatched
+        std::size_t size() const;
+        bool empty() const { return size() == 0; }
+
+
+    private: // used by the engine
+        friend struct engine;
+
+        // copy a message with the objects of its `object` arguments, and take its file descriptors from the engine
+        void push(proto::interface & object, proto::event_dispatch_fn dispatcher, std::span<const char> message,
+            std::span<proto::interface * const> arguments, detail::fd_ring & fds, std::size_t fd_count);
+
+        // the object was destroyed: its queued events are discarded, and it is passed as nullptr to the others
+        void forget(const proto::interface & object);
+
+
+    private:
+        // queued message, followed by the message data (padded to the alignment of this header)
+        struct event_header
+        {
+            proto::interface * object;      // null when the object was destroyed
+            proto::event_dispatch_fn dispatcher;
+            std::uint32_t size;
+            std::uint32_t fd_count;
+            std::uint32_t argument_count;   // objects of the event in the object list
+        };
+
+        static void forget(std::vector<char> & events, std::vector<proto::interface *> & arguments, const proto::interface & object);
+        static void close_fds(std::span<const int> fds);
+
+
+    private:
+        engine & m_engine;
+
+        mutable std::mutex m_mutex;
+        std::vector<char> m_events{};                       // guarded by `m_mutex`
+        std::vector<int> m_fds{};                           // guarded by `m_mutex`
+        std::vector<proto::interface *> m_arguments{};      // guarded by `m_mutex`
+        std::size_t m_event_count = 0;                      // guarded by `m_mutex`
+
+        // events taken by `dispatch_pending` (the buffers are swapped, so their memory is reused)
+        // the headers and objects are guarded by `m_mutex` (objects destroyed by other threads are forgotten in them)
+        std::vector<char> m_dispatch_events{};
+        std::vector<int> m_dispatch_fds{};
+        std::vector<proto::interface *> m_dispatch_arguments{};
+
+        // objects of the event being dispatched (copied out of `m_dispatch_arguments`)
+        std::vector<proto::interface *> m_event_arguments{};
+    };
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+
+namespace dd99::wayland
+{
+
+    // enough for a lambda capturing a few pointers, or an object pointer and a member function pointer
+    inline constexpr std::size_t inplace_function_default_capacity = 3 * sizeof(void *);
+
+
+    template <class Signature, std::size_t Capacity = inplace_function_default_capacity>
+    class inplace_function;
+
+    // Callable wrapper (like `std::function`) that stores the callable inside the object: it never allocates.
+    // Callables larger than `Capacity` (or over-aligned) are rejected at compile time.
+    // Calls are one indirect call (the invoker is stored in the object, there is no vtable).
+    // Callables must be copy-constructible.
+    template <class R, class ... Args, std::size_t Capacity>
+    class inplace_function<R(Args...), Capacity>
+    {
+    public:
+        inplace_function() = default;
+        inplace_function(std::nullptr_t) { }
+
+        template <class F>
+            requires (!std::same_as<std::remove_cvref_t<F>, inplace_function>)
+                  && std::invocable<std::decay_t<F> &, Args...>
+        inplace_function(F && f)
+        {
+            emplace(std::forward<F>(f));
+        }
+
+        inplace_function(const inplace_function & other) { assign(other); }
+        inplace_function(inplace_function && other) noexcept { assign(std::move(other)); }
+
+        inplace_function & operator=(const inplace_function & other)
+        {
+            if (this != &other) { reset(); assign(other); }
+            return *this;
+        }
+
+        inplace_function & operator=(inplace_function && other) noexcept
+        {
+            if (this != &other) { reset(); assign(std::move(other)); }
+            return *this;
+        }
+
+        inplace_function & operator=(std::nullptr_t) { reset(); return *this; }
+
+        template <class F>
+            requires (!std::same_as<std::remove_cvref_t<F>, inplace_function>)
+                  && std::invocable<std::decay_t<F> &, Args...>
+        inplace_function & operator=(F && f)
+        {
+            reset();
+            emplace(std::forward<F>(f));
+            return *this;
+        }
+
+        ~inplace_function() { reset(); }
+
+
+    public: // API
+        R operator()(Args ... args) const
+        {
+            return m_invoke(&m_storage, std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const { return m_invoke != nullptr; }
+
+        void reset()
+        {
+            if (m_manage) m_manage(operation::destroy, &m_storage, nullptr);
+            m_invoke = nullptr;
+            m_manage = nullptr;
+        }
+
+
+    private:
+        enum class operation { copy, move, destroy };
+
+        struct alignas(std::max_align_t) storage_t { std::byte data[Capacity]; };
+
+        // copies (or moves) the callable of `other` (this function must be empty)
+        template <class Other>
+        void assign(Other && other)
+        {
+            m_invoke = other.m_invoke;
+            m_manage = other.m_manage;
+
+            // trivially copyable callables are copied as bytes
+            if (!m_manage) m_storage = other.m_storage;
+            else if constexpr (std::is_const_v<std::remove_reference_t<Other>>) m_manage(operation::copy, &m_storage, &other.m_storage);
+            else m_manage(operation::move, &m_storage, &other.m_storage);
+        }
+
+        template <class F>
+        void emplace(F && f)
+        {
+            using callable_t = std::decay_t<F>;
+            static_assert(sizeof(callable_t) <= Capacity, "callable too large for this inplace_function (increase its capacity)");
+            static_assert(alignof(callable_t) <= alignof(storage_t), "over-aligned callables are not supported");
+            static_assert(std::is_copy_constructible_v<callable_t>);
+
+            // a null function pointer makes an empty function
+            if constexpr (std::is_pointer_v<callable_t> || std::is_member_pointer_v<callable_t>)
+                if (f == nullptr) return;
+
+            new (&m_storage) callable_t(std::forward<F>(f));
+
+            m_invoke = [](storage_t * storage, Args && ... args) -> R
+            {
+                return std::invoke(*std::launder(reinterpret_cast<callable_t *>(storage)), std::forward<Args>(args)...);
+            };
+
+            // trivial callables (e.g. lambdas capturing pointers) need no management
+            if constexpr (!std::is_trivially_copyable_v<callable_t>) m_manage = [](operation op, storage_t * storage, storage_t * other)
+            {
+                const auto callable = [](storage_t * s){ return std::launder(reinterpret_cast<callable_t *>(s)); };
+                switch (op)
+                {
+                    case operation::copy: new (storage) callable_t(std::as_const(*callable(other))); break;
+                    case operation::move: new (storage) callable_t(std::move(*callable(other))); break;
+                    case operation::destroy: std::destroy_at(callable(storage)); break;
+                }
+            };
+        }
+
+        mutable storage_t m_storage{};
+        R (*m_invoke)(storage_t *, Args && ...) = nullptr;
+        void (*m_manage)(operation, storage_t *, storage_t *) = nullptr;
+    };
+
+}
@@ -1,20 +1,60 @@
 #pragma once
 
 
+#include <dd99/wayland/awaitable.hpp> // used by interfaces that include this file
 #include <dd99/wayland/engine.hpp>
+#include <dd99/wayland/inplace_function.hpp> // used by interfaces that include this file
 // #include <dd99/wayland/interface_binder.hpp>
 #include <dd99/wayland/interface_concept.hpp>
 #include <dd99/wayland/message_marshaling.hpp>
 #include <dd99/wayland/message_parsing.hpp> // used by interfaces that include this file
 #include <dd99/wayland/types.hpp>
 
+#include <bit> // used by interfaces that include this file
+#include <cstdint>
+#include <span>
+#include <string_view>
 #include <type_traits>
+#include <unistd.h> // used by interfaces that include this file (default handlers close received file descriptors)
 
 
 
 namespace dd99::wayland::proto
 {
 
+    struct interface;
+
+    // decoder of an event: decodes the message (header included) and calls the handler of `object`
+    using event_dispatch_fn = void (*)(interface & object, std::span<const char> data);
+
+    // how `process_input` merges repeated events of an object within a frame (see `engine::set_event_coalescing`)
+    // offsets are in bytes from the start of the message (header included), and name 32-bit arguments
+    struct event_coalescing
+    {
+        static constexpr std::uint8_t no_key = 0xFF;
+
+        enum class mode_t : std::uint8_t
+        {
+            none,       // not coalesced (flushes the events held back)
+            latest,     // a repeated event replaces the one held back
+            sum,        // like latest, but the argument at `sum_offset` is the sum of both (fixed or int)
+        };
+
+        mode_t mode = mode_t::none;
+        std::uint8_t key_offset = no_key;   // events with a different value of this argument are not merged (i.e. touch id, axis)
+        std::uint8_t sum_offset = 0;
+    };
+
+    // Event tables of an interface class, indexed by opcode. One static instance per class (generated):
+    // the engine keeps a pointer to it in the slot of each object.
+    struct interface_descriptor
+    {
+        std::span<const event_dispatch_fn> event_dispatchers{};         // decoder of each event
+        std::span<const std::uint8_t> event_fd_counts{};                // file descriptors carried by each event (empty when none does)
+        std::span<const std::string_view> event_signatures{};           // wire signature of each event (see `input_validation::checked`)
+        std::span<const event_coalescing> event_coalescing_rules{};     // coalescing rule of each event (empty when none is coalesced)
+    };
+
     // base class for all protocol-defined interfaces
     // objects are instances of derived classes
     // derived classes are generated from xml protocol descriptions
@@ -23,9 +63,14 @@ namespace dd99::wayland::proto
     protected: // types
         friend dd99::wayland::engine;
 
+        static constexpr interface_descriptor no_event_descriptor{};
+
 
     public: // constructor/destructor
-        virtual ~interface() = default;
+        virtual ~interface()
+        {
+            if (m_object_id != 0) m_engine.detach_interface(*this);
+        }
 
         interface(engine & eng)
             : m_engine{eng}
@@ -47,6 +92,9 @@ namespace dd99::wayland::proto
         auto get_id() const { return m_object_id; }
         auto get_version() const { return m_version; }
         virtual std::string_view get_interface_name() const = 0;
+
+        // event tables of the class (interfaces without events have empty tables)
+        virtual const interface_descriptor & get_interface_descriptor() const { return no_event_descriptor; }
         // virtual static_data_t & get_interface_static_data() = 0;
 
     
@@ -54,9 +102,10 @@ namespace dd99::wayland::proto
         template <class ... Args>
         void send_wayland_message(opcode_t opcode, std::span<int> ancillary_fds, Args && ... args);
 
-
-    protected: // functions that derived classes must implement (generated from xml)
-        virtual void parse_and_dispatch_event(std::span<const char> data) = 0;
+        // send a message already laid out as it goes on the wire (header included)
+        template <class Layout>
+        void send_wayland_message_layout(std::span<int> ancillary_fds, const Layout & message)
+        { dd99::wayland::detail::message_store(m_engine, ancillary_fds, message); }
 
 
     protected: // member variables
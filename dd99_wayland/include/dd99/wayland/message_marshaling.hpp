@@ -4,18 +4,49 @@
 #include <concepts>
 #include <dd99/wayland/engine.hpp>
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string_view>
 #include <type_traits>
 #include <utility>
 #include <span>
+#include <sys/uio.h>
 
 
 
 namespace dd99::wayland::detail
 {
 
+    // messages up to this size are assembled in a stack buffer
+    // bigger messages (only possible with long strings or arrays) use a temporary heap buffer
+    inline constexpr std::size_t max_stack_message_size = 4096;
+
+    // size of the message header: object id, then 16-bit size and 16-bit opcode
+    inline constexpr std::size_t message_header_size = sizeof(object_id_t) + sizeof(message_size_t) + sizeof(opcode_t);
+
+    // string and array payloads of at least this size are not copied by the marshaller
+    // they are referenced in place, and the message is output as a list of `iovec` (see `engine::on_output_iov`)
+    inline constexpr std::size_t zero_copy_payload_threshold = 256;
+
+
+    // true for argument types that carry a variable-size payload (strings and arrays)
+    template <class T>
+    inline constexpr bool _is_payload_type = std::same_as<std::remove_cvref_t<T>, proto::zview>
+                                          || std::same_as<std::remove_cvref_t<T>, std::span<const char>>;
+
+    // size of the payload that will be referenced in place instead of copied (0 for all other arguments)
+    template <class T>
+    inline constexpr std::size_t _referenced_payload_size(const T & v)
+    {
+        if constexpr (_is_payload_type<T>) return (v.size() >= zero_copy_payload_threshold) ? v.size() : 0;
+        else return 0;
+    }
+
+
     template <class T>
     inline constexpr std::size_t _marshal_size_one(T && v)
     {
@@ -42,12 +73,21 @@ namespace dd99::wayland::detail
         }
     }
 
+    // wire size of an argument type when it is known at compile time
+    // returns 0 for types whose size depends on the value (strings and arrays)
     template <class T>
-    inline constexpr void message_marshal_one(engine & eng, std::span<int> fds, const T & v)
+    inline consteval std::size_t _marshal_static_size()
     {
-        constexpr proto::zview zeroes = "\0\0";
-        // TODO: array
+        if constexpr (_is_payload_type<T>) return 0;
+        else return sizeof(std::remove_cvref_t<T>);
+    }
 
+    // writes the wire representation of `v` at `out`
+    // `out` must have room for `_marshal_size_one(v)` bytes
+    // @RETURN: pointer past the last written byte
+    template <class T>
+    inline char * message_marshal_one(char * out, const T & v)
+    {
         if constexpr (std::same_as<std::remove_cvref_t<T>, proto::zview>)
         {
             auto wire_size = _marshal_size_one(v);
@@ -56,9 +96,12 @@ namespace dd99::wayland::detail
 
             assert(padding_size < 4);
 
-            eng.on_output({reinterpret_cast<char *>(&str_size), sizeof(str_size)}, {});
-            eng.on_output({v.data(), str_size}, fds);
-            eng.on_output({zeroes.data(), padding_size}, {});
+            std::memcpy(out, &str_size, sizeof(str_size));
+            out += sizeof(str_size);
+            if (!v.empty()) std::memcpy(out, v.data(), v.size());
+            out += v.size();
+            std::memset(out, 0, 1 + padding_size); // null terminator and padding
+            return out + 1 + padding_size;
         }
         else if constexpr (std::same_as<std::remove_cvref_t<T>, std::span<const char>>)
         {
@@ -68,52 +111,142 @@ namespace dd99::wayland::detail
             
             assert(padding_size < 4);
 
-            eng.on_output({reinterpret_cast<char *>(&array_size), sizeof(array_size)}, {});
-            eng.on_output(v, fds);
-            eng.on_output({zeroes.data(), padding_size}, {});
+            std::memcpy(out, &array_size, sizeof(array_size));
+            out += sizeof(array_size);
+            if (!v.empty()) std::memcpy(out, v.data(), v.size());
+            out += v.size();
+            std::memset(out, 0, padding_size);
+            return out + padding_size;
         }
         else // most things used here are already binary compatible and have a size that is a multiple of 32-bit
         {
-            eng.on_output({reinterpret_cast<const char *>(&v), sizeof(v)}, fds);
+            std::memcpy(out, &v, sizeof(v));
+            return out + sizeof(v);
         }
     }
 
+    // Scatter/gather variant of `message_marshal_one`.
+    // Large payloads are not copied: the current scratch segment is closed and the payload is referenced by its own `iovec`.
+    // Everything else (including length words, null terminators and padding) is written to the scratch buffer at `out`.
+    // @RETURN: pointer past the last byte written to the scratch buffer
+    template <class T>
+    inline char * message_marshal_one_iov(char * out, char *& segment_begin, ::iovec *& iov, const T & v)
+    {
+        if constexpr (_is_payload_type<T>)
+        {
+            if (_referenced_payload_size(v) != 0)
+            {
+                constexpr bool is_string = std::same_as<std::remove_cvref_t<T>, proto::zview>;
+                auto length = static_cast<std::uint32_t>(v.size() + (is_string ? 1 : 0)); // strings count the null terminator
+                auto tail_size = _marshal_size_one(v) - sizeof(length) - v.size(); // null terminator and padding
+
+                std::memcpy(out, &length, sizeof(length));
+                out += sizeof(length);
+
+                *iov++ = {segment_begin, static_cast<std::size_t>(out - segment_begin)};
+                *iov++ = {const_cast<char *>(v.data()), v.size()};
+                segment_begin = out;
+
+                std::memset(out, 0, tail_size);
+                return out + tail_size;
+            }
+        }
+
+        return message_marshal_one(out, v);
+    }
+
+    // Assembles a message whose large payloads are referenced in place and outputs it as a list of `iovec`.
+    // `scratch` must have room for the message minus the referenced payloads.
     template <class ... Args>
-    inline constexpr void message_marshal(engine & eng, object_id_t id, opcode_t opcode, std::span<int> fds, Args && ... args)
+    inline void message_marshal_iov(engine & eng, char * scratch, std::uint32_t size_and_opcode, object_id_t id, std::span<int> fds, const Args & ... args)
     {
-        std::uint32_t size = _marshal_size_one(id)
-                            + _marshal_size_one(opcode)
-                            + _marshal_size_one(message_size_t{})
-                            + (_marshal_size_one(args) + ... + 0);
+        // one scratch segment before and after each referenced payload
+        ::iovec iovs[1 + 2 * (std::size_t{_is_payload_type<Args>} + ... + 0)];
+        ::iovec * iov = iovs;
+        char * segment_begin = scratch;
 
-        message_marshal_one(eng, {}, id);
-        if constexpr (sizeof...(args) == 0) message_marshal_one(eng, fds, (size << 16) | opcode);
-        else
-        {
+        auto out = message_marshal_one(scratch, id);
+        out = message_marshal_one(out, size_and_opcode);
+        ((out = message_marshal_one_iov(out, segment_begin, iov, args)), ...);
+        if (out != segment_begin) *iov++ = {segment_begin, static_cast<std::size_t>(out - segment_begin)};
 
-            message_marshal_one(eng, {}, (size << 16) | opcode);
+        eng.write_message(std::span<const ::iovec>{iovs, iov}, fds);
+    }
 
-            [&]<class Tup, std::size_t ... I>(const Tup & tup, std::index_sequence<I...>){
-                (((I < sizeof...(args) - 1)
-                    ? message_marshal_one(eng, {}, std::get<I>(tup))
-                    : message_marshal_one(eng, fds, std::get<I>(tup))), ...);
-            }(std::forward_as_tuple(args...), std::make_index_sequence<sizeof...(args)>());
+    // The whole message (header and arguments) is assembled in a single buffer
+    // and handed to the engine with a single call to `engine::write_message`.
+    // File descriptors travel along with the message.
+    // 
+    // Messages that carry large strings or arrays (see `zero_copy_payload_threshold`) are not copied.
+    // The header and the remaining arguments are assembled in a scratch buffer and the payloads are referenced in place.
+    template <class ... Args>
+    inline void message_marshal(engine & eng, object_id_t id, opcode_t opcode, std::span<int> fds, Args && ... args)
+    {
+        // the size is known at compile time when there are no strings or arrays
+        constexpr bool is_fixed_size = ((_marshal_static_size<Args>() != 0) && ...);
 
-        }
+        const std::size_t size = message_header_size + (_marshal_size_one(args) + ... + 0);
+        assert(size <= std::numeric_limits<message_size_t>::max());
+
+        auto assemble_and_output = [&](char * buf)
+        {
+            auto out = message_marshal_one(buf, id);
+            out = message_marshal_one(out, static_cast<std::uint32_t>((size << 16) | opcode));
+            ((out = message_marshal_one(out, args)), ...);
+            assert(out == buf + size);
+
+            eng.write_message({buf, size}, fds);
+        };
 
-        // message_marshal_one(eng, fds, id);
-        // message_marshal_one(eng, {}, (size << 16) | opcode);
-        // (message_marshal_one(eng, {}, std::forward<Args>(args)),...);
+        if constexpr (is_fixed_size)
+        {
+            alignas(std::uint32_t) char buf[message_header_size + (_marshal_static_size<Args>() + ... + 0)];
+            assemble_and_output(buf);
+        }
+        else
+        {
+            const std::size_t referenced_size = (_referenced_payload_size(args) + ... + 0);
+
+            if (referenced_size != 0)
+            {
+                const auto size_and_opcode = static_cast<std::uint32_t>((size << 16) | opcode);
+                const auto scratch_size = size - referenced_size;
+
+                if (scratch_size <= max_stack_message_size) [[likely]]
+                {
+                    alignas(std::uint32_t) char scratch[max_stack_message_size];
+                    message_marshal_iov(eng, scratch, size_and_opcode, id, fds, args...);
+                }
+                else [[unlikely]]
+                {
+                    auto scratch = std::make_unique_for_overwrite<char[]>(scratch_size);
+                    message_marshal_iov(eng, scratch.get(), size_and_opcode, id, fds, args...);
+                }
+            }
+            else if (size <= max_stack_message_size) [[likely]]
+            {
+                alignas(std::uint32_t) char buf[max_stack_message_size];
+                assemble_and_output(buf);
+            }
+            else [[unlikely]]
+            {
+                auto buf = std::make_unique_for_overwrite<char[]>(size);
+                assemble_and_output(buf.get());
+            }
+        }
     }
 
-    // inline constexpr void message_marshal(engine & eng, object_id_t id, opcode_t opcode, std::span<int> fds)
-    // {
-    //     std::uint32_t size = _marshal_size_one(id)
-    //                         + _marshal_size_one(opcode)
-    //                         + _marshal_size_one(message_size_t{});
+    // Stores a message whose wire layout is known at compile time (used by generated code for fixed-size requests).
+    // `Layout` is a struct with the exact wire representation of the message, header included.
+    template <class Layout>
+    inline void message_store(engine & eng, std::span<int> fds, const Layout & message)
+    {
+        static_assert(std::is_trivially_copyable_v<Layout>);
+        static_assert(sizeof(Layout) >= message_header_size);
+        static_assert(sizeof(Layout) % sizeof(std::uint32_t) == 0);
+        static_assert(sizeof(Layout) <= std::numeric_limits<message_size_t>::max());
 
-    //     message_marshal_one(eng, {}, id);
-    //     message_marshal_one(eng, fds, (size << 16) | opcode);
-    // }
+        eng.write_message({reinterpret_cast<const char *>(&message), sizeof(Layout)}, fds);
+    }
 
 }
@@ -3,8 +3,11 @@
 #include "dd99/wayland/detail/zview.hpp"
 #include "dd99/wayland/interface.hpp"
 #include "dd99/wayland/types.hpp"
+#include <bit>
+#include <cassert>
 #include <concepts>
 #include <cstdint>
+#include <cstring>
 #include <span>
 #include <string_view>
 #include <tuple>
@@ -14,6 +17,49 @@
 namespace dd99::wayland::proto
 {
 
+    // Loaders used by generated event decoding (straight-line code, one call per argument).
+    // Arguments before the first string or array are loaded at constant offsets.
+    // Strings and arrays (and every argument after them) use a running offset.
+    // The message was already checked to be complete (and validated, see `input_validation`), so the loads are not bounds-checked.
+
+    // argument with a 32-bit wire representation (int, uint, fixed, enum, object id)
+    template <class T>
+    T load_msg_arg(const char * data)
+    {
+        static_assert(sizeof(T) == sizeof(std::uint32_t));
+        std::uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        return std::bit_cast<T>(word);
+    }
+
+    // string at `data + offset`. `offset` is moved past the (padded) string
+    inline zview load_msg_string(const char * data, std::size_t & offset)
+    {
+        const auto size = load_msg_arg<std::uint32_t>(data + offset);
+        offset += sizeof(std::uint32_t);
+
+        // null string (allowed by nullable arguments)
+        if (size == 0) return {};
+
+        // size - 1 because we want to ignore the null terminator
+        assert(data[offset + size - 1] == 0); // null terminator
+        zview str{data + offset, size - 1};
+        offset += (size + sizeof(std::uint32_t) - 1) & ~(sizeof(std::uint32_t) - 1);
+        return str;
+    }
+
+    // array at `data + offset`. `offset` is moved past the (padded) array
+    inline std::span<const char> load_msg_array(const char * data, std::size_t & offset)
+    {
+        const auto size = load_msg_arg<std::uint32_t>(data + offset);
+        offset += sizeof(std::uint32_t);
+
+        std::span<const char> array{data + offset, size};
+        offset += (size + sizeof(std::uint32_t) - 1) & ~(sizeof(std::uint32_t) - 1);
+        return array;
+    }
+
+
     // returns the number of consumed bytes and the parsed element
     template <class T>
     std::pair<std::size_t, T> parse_msg_arg(std::span<const char> buffer)
@@ -25,7 +71,10 @@ namespace dd99::wayland::proto
         {
             auto size = *reinterpret_cast<const std::uint32_t *>(buffer.data());
             auto size_aligned_to_32bit = (size + sizeof(std::uint32_t) - 1) & ~(sizeof(std::uint32_t) - 1);
-            
+
+            // null string (allowed by nullable arguments)
+            if (size == 0) return {sizeof(std::uint32_t), zview{}};
+
             // size - 1 because we want to ignore the null terminator
             zview str{buffer.data() + sizeof(std::uint32_t), size - 1};
             assert(buffer.data()[sizeof(std::uint32_t) + size - 1] == 0); // null terminator
@@ -0,0 +1,82 @@
+#pragma once
+
+
+#include <cstddef>
+#include <span>
+#include <utility>
+
+
+
+namespace dd99::wayland
+{
+
+    // Receive buffer with a fixed capacity, backed by the same memory mapped twice back to back.
+    // Any window of the ring is contiguous in memory, so data never needs to be compacted:
+    // a partial trailing message simply waits in place until the rest arrives,
+    // and `engine::process_input` always gets a single span.
+    //
+    // Usage:
+    //  auto window = ring.write_window();
+    //  auto n = ::read(fd, window.data(), window.size());
+    //  ring.commit(n);
+    //  ring.consume(eng.process_input(ring.read_window()));
+    struct mirrored_ring_buffer
+    {
+        // The capacity is rounded up to a multiple of the page size.
+        // Throws `std::system_error` when the mapping can not be created.
+        explicit mirrored_ring_buffer(std::size_t min_capacity);
+        ~mirrored_ring_buffer();
+
+        mirrored_ring_buffer(const mirrored_ring_buffer &) = delete;
+        mirrored_ring_buffer & operator=(const mirrored_ring_buffer &) = delete;
+
+        mirrored_ring_buffer(mirrored_ring_buffer && other) noexcept
+            : m_data{std::exchange(other.m_data, nullptr)}
+            , m_capacity{std::exchange(other.m_capacity, 0)}
+            , m_read_pos{std::exchange(other.m_read_pos, 0)}
+            , m_size{std::exchange(other.m_size, 0)}
+        { }
+
+        mirrored_ring_buffer & operator=(mirrored_ring_buffer && other) noexcept
+        {
+            std::swap(m_data, other.m_data);
+            std::swap(m_capacity, other.m_capacity);
+            std::swap(m_read_pos, other.m_read_pos);
+            std::swap(m_size, other.m_size);
+            return *this;
+        }
+
+
+    public:
+        // stored data, contiguous
+        std::span<const char> read_window() const { return {m_data + m_read_pos, m_size}; }
+
+        // free space, contiguous. Data written here becomes readable after `commit`
+        std::span<char> write_window() { return {m_data + m_read_pos + m_size, m_capacity - m_size}; }
+
+        // makes `count` bytes written to `write_window()` readable
+        void commit(std::size_t count) { m_size += count; }
+
+        // drops `count` bytes from the front of `read_window()`
+        void consume(std::size_t count)
+        {
+            m_size -= count;
+            m_read_pos += count;
+            if (m_read_pos >= m_capacity) m_read_pos -= m_capacity;
+            if (m_size == 0) m_read_pos = 0;
+        }
+
+        std::size_t capacity() const { return m_capacity; }
+        std::size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        bool full() const { return m_size == m_capacity; }
+
+
+    private:
+        char * m_data = nullptr;        // `2 * m_capacity` bytes mapped (the second half mirrors the first)
+        std::size_t m_capacity = 0;
+        std::size_t m_read_pos = 0;     // always in [0, m_capacity)
+        std::size_t m_size = 0;
+    };
+
+}
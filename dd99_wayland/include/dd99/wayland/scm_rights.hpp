@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <sys/socket.h>
+
+
+
+namespace dd99::wayland
+{
+
+    // Maximum number of file descriptors sent with one `sendmsg`.
+    // Compositors (libwayland-server) receive at most this many file descriptors per read.
+    inline constexpr std::size_t max_fds_per_message = 28;
+
+
+    // Preallocated control-message buffer for passing file descriptors (SCM_RIGHTS) with `sendmsg`/`recvmsg`.
+    // Intended to be kept by the transport and reused for every write, instead of allocating per call.
+    // 
+    // Usage:
+    //  ::msghdr msg{ ... };
+    //  m_scm_rights.attach(msg, fds); // sets msg_control and msg_controllen (or clears them if `fds` is empty)
+    //  ::sendmsg(fd, &msg, 0);
+    template <std::size_t Max_FDs = max_fds_per_message>
+    struct scm_rights_buffer
+    {
+        static constexpr std::size_t max_fds = Max_FDs;
+
+        void attach(::msghdr & msg, std::span<const int> fds)
+        {
+            assert(fds.size() <= max_fds);
+
+            if (fds.empty())
+            {
+                msg.msg_control = nullptr;
+                msg.msg_controllen = 0;
+                return;
+            }
+
+            const auto data_size = sizeof(int) * fds.size();
+
+            msg.msg_control = m_buf;
+            msg.msg_controllen = CMSG_SPACE(data_size);
+
+            auto cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(data_size);
+            std::memcpy(CMSG_DATA(cmsg), fds.data(), data_size);
+        }
+
+        // Prepares `msg` to receive up to `max_fds` file descriptors with `recvmsg`.
+        // Received file descriptors are read back with `for_each_received_fd`.
+        void prepare_receive(::msghdr & msg)
+        {
+            msg.msg_control = m_buf;
+            msg.msg_controllen = sizeof(m_buf);
+        }
+
+        // calls `f(fd)` for each file descriptor received with `recvmsg` (in order)
+        template <class F>
+        static void for_each_received_fd(::msghdr & msg, F && f)
+        {
+            for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+                const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const auto data = CMSG_DATA(cmsg);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    int fd;
+                    std::memcpy(&fd, data + i * sizeof(int), sizeof(int));
+                    f(fd);
+                }
+            }
+        }
+
+    private:
+        alignas(::cmsghdr) char m_buf[CMSG_SPACE(sizeof(int) * Max_FDs)];
+    };
+
+}
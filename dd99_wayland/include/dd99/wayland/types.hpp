@@ -1,6 +1,7 @@
 #pragma once
 
 #include <dd99/wayland/detail/zview.hpp>
+#include <cstddef>
 #include <cstdint>
 
 
@@ -12,6 +13,17 @@ namespace dd99::wayland
     using opcode_t = std::uint16_t;
     using message_size_t = std::uint16_t;
 
+    // set of events of an interface (bit `n` is the event with opcode `n`). Only the first 64 opcodes can be masked
+    using event_mask_t = std::uint64_t;
+    inline constexpr std::size_t event_mask_bits = 64;
+
+    // mask of events, from their opcodes (generated interfaces enumerate them in `events`, e.g. `pointer::events::axis_discrete`)
+    template <class ... Events>
+    constexpr event_mask_t event_mask(Events ... events)
+    {
+        return (event_mask_t{0} | ... | (event_mask_t{1} << static_cast<opcode_t>(events)));
+    }
+
     namespace proto
     {
         struct fixed_point
@@ -0,0 +1,92 @@
+#pragma once
+
+
+#include <dd99/wayland/engine.hpp>
+#include <dd99/wayland/mirrored_ring_buffer.hpp>
+#include <dd99/wayland/scm_rights.hpp>
+
+#include <cstddef>
+#include <span>
+#include <sys/uio.h>
+
+
+
+namespace dd99::wayland
+{
+
+    // Engine with a built-in transport: a non-blocking Unix socket connected to the wayland server.
+    //
+    // Output buffering is enabled on construction. Requests are collected in the output buffer
+    // and sent with one `sendmsg` per `flush()` (file descriptors travel as SCM_RIGHTS ancillary data).
+    // When the socket would block, unsent data stays buffered: wait until `get_fd()` is writable and call `flush()` again.
+    //
+    // Typical event loop:
+    //  flush();
+    //  poll get_fd() for POLLIN (and POLLOUT while pending_output_size() != 0)
+    //  read_events();
+    //  dispatch_pending();
+    //
+    // Errors are reported with exceptions (`std::system_error` for failed system calls).
+    // It can be derived from to handle engine events (i.e. `on_output_high_watermark`).
+    struct unix_socket_engine : engine
+    {
+        // fits the largest wayland message
+        static constexpr std::size_t input_buffer_size = 64 * 1024;
+
+        // Connects to the wayland server named by the environment, like libwayland does:
+        // `WAYLAND_SOCKET` (an already connected fd), or `WAYLAND_DISPLAY` (default "wayland-0"),
+        // which is relative to `XDG_RUNTIME_DIR` unless it is an absolute path.
+        unix_socket_engine();
+
+        // Takes ownership of an already connected socket. The socket is switched to non-blocking mode.
+        explicit unix_socket_engine(int fd);
+
+        virtual ~unix_socket_engine();
+
+        unix_socket_engine(const unix_socket_engine &) = delete;
+        unix_socket_engine(unix_socket_engine &&) = delete; // interfaces keep a reference to their engine
+
+
+    public: // Transport API
+
+        // pollable socket file descriptor
+        int get_fd() const { return m_fd; }
+
+        // Reads everything available on the socket without blocking (or until the input buffer is full).
+        // Complete messages are not dispatched until `dispatch_pending()` is called.
+        // Throws when the server closed the connection and nothing was read.
+        // @RETURN: bytes read
+        std::size_t read_events();
+
+        // Dispatches the complete messages already read. A partial message is kept until the rest arrives.
+        // @RETURN: bytes consumed
+        std::size_t dispatch_pending();
+
+        // `flush()`, `read_events()` and `dispatch_pending()`, without blocking.
+        // @RETURN: bytes consumed by `dispatch_pending()`
+        std::size_t dispatch();
+
+
+    public: // engine I/O events
+
+        // Only used while output buffering is disabled. Sends the message right away, waiting for the socket if needed.
+        void on_output(std::span<const char> data, std::span<int> fds) override;
+
+        // one non-blocking `sendmsg`. Returns 0 when the socket would block
+        std::size_t on_flush(std::span<const ::iovec> data, std::span<int> fds) override;
+
+
+    private:
+        void wait_for(short events);
+
+
+    private:
+        int m_fd;
+
+        mirrored_ring_buffer m_input_buffer{input_buffer_size};
+
+        scm_rights_buffer<> m_scm_rights_out{};
+        scm_rights_buffer<> m_scm_rights_in{};
+    };
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+
+#include <dd99/wayland/engine.hpp>
+#include <dd99/wayland/scm_rights.hpp>
+
+#include <liburing.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
+
+
+
+namespace dd99::wayland
+{
+
+    struct uring_engine_config
+    {
+        unsigned queue_depth = 64;
+        unsigned input_buffer_count = 64;               // must be a power of 2
+        std::size_t input_buffer_size = 16 * 1024;
+        std::size_t output_slot_count = 8;
+        std::size_t output_slot_size = 64 * 1024;
+    };
+
+
+    // Engine with an io_uring transport (`dd99_wayland_uring` target, only built when liburing is found).
+    //
+    // Input:
+    // A single multishot `recvmsg` keeps receiving until it is cancelled. It picks its buffers from a provided-buffer ring.
+    // Received data is passed to `process_input` straight from the completion buffers, which are then given back to the ring.
+    // Only a message that straddles two buffers is copied. Received file descriptors are queued by the engine (see `engine::push_input_fds`).
+    //
+    // Output:
+    // Output buffering is enabled on construction. Each chunk handed to `on_flush` is copied to a send slot.
+    // Queued slots are submitted as one chain of linked sends. Only one chain is in flight at a time, which keeps the stream ordered.
+    // File descriptors are duplicated when queued, sent with `sendmsg` and closed once sent.
+    // When every slot is in use, `on_flush` accepts nothing and the data stays in the engine's output buffer.
+    //
+    // Event loop:
+    // Call `run_once()`. It submits queued sends and waits for completions with a single `io_uring_enter`,
+    // then dispatches received events. The ring fd (`get_fd()`) can be polled: it is readable when completions are pending.
+    struct uring_engine : engine
+    {
+        // takes ownership of a connected socket
+        explicit uring_engine(int fd);
+        uring_engine(int fd, const uring_engine_config & config);
+        virtual ~uring_engine();
+
+        uring_engine(const uring_engine &) = delete;
+        uring_engine & operator=(const uring_engine &) = delete;
+        uring_engine(uring_engine &&) = delete; // interfaces keep a reference to their engine
+
+
+    public: // Transport API
+
+        // pollable io_uring file descriptor
+        int get_fd() const { return m_ring.ring_fd; }
+
+        // Flushes output, submits pending requests and processes completions. Received events are dispatched.
+        // @param wait: block until at least one completion arrives
+        // @RETURN: bytes dispatched
+        std::size_t run_once(bool wait = true);
+
+        // false after the server closed the connection
+        bool is_connected() const { return m_connected; }
+
+
+    public: // engine I/O events
+
+        // Only used while output buffering is disabled. Queues the message, waiting for a free send slot if needed.
+        void on_output(std::span<const char> data, std::span<int> fds) override;
+
+        // Copies data to a free send slot and queues it. Returns 0 when every slot is in use.
+        std::size_t on_flush(std::span<const ::iovec> data, std::span<int> fds) override;
+
+
+    private:
+        struct send_slot
+        {
+            char * data = nullptr;
+            std::size_t size = 0;           // queued bytes
+            std::size_t sent = 0;
+            std::vector<int> fds{};         // duplicated. Closed once sent
+            ::iovec iov{};
+            ::msghdr msg{};
+            scm_rights_buffer<> scm_rights{};
+        };
+
+        // data received in a provided buffer, not yet dispatched
+        struct received_data
+        {
+            unsigned short buffer_id;
+            const char * data;
+            std::size_t size;
+        };
+
+        void arm_receive();
+        void submit_output();
+        void reap_completions();
+        void handle_receive(const ::io_uring_cqe & cqe);
+        void handle_send(const ::io_uring_cqe & cqe);
+        std::size_t dispatch_received();
+        void return_input_buffer(unsigned short buffer_id);
+        void close_slot_fds(send_slot & slot);
+
+
+    private:
+        static constexpr int input_buffer_group = 0;
+        static constexpr std::uint64_t receive_user_data = ~std::uint64_t{0};
+        static constexpr std::uint64_t cancel_user_data = ~std::uint64_t{1};
+
+        int m_fd;
+        uring_engine_config m_config;
+        ::io_uring m_ring{};
+        bool m_connected = true;
+
+        // input
+        std::unique_ptr<char[]> m_input_memory;
+        ::io_uring_buf_ring * m_input_ring = nullptr;
+        ::msghdr m_receive_msg{};
+        bool m_receive_armed = false;
+        std::deque<received_data> m_received{};
+        std::vector<char> m_partial_message{};     // message straddling two buffers
+
+        // output
+        std::unique_ptr<char[]> m_output_memory;
+        std::vector<send_slot> m_slots{};
+        std::vector<std::size_t> m_free_slots{};
+        std::deque<std::size_t> m_queued_slots{};  // in stream order
+        std::size_t m_sends_in_flight = 0;
+    };
+
+}
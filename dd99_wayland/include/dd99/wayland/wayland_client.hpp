@@ -23,4 +23,5 @@
 
 
 #include <dd99/wayland/engine.hpp>
+#include <dd99/wayland/event_queue.hpp>
 #include <dd99/wayland/interface.hpp>
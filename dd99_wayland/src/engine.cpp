@@ -3,10 +3,13 @@
 #include <dd99/wayland/types.hpp>
 #include "engine_data.hpp"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <unistd.h>
+#include <utility>
 
 
 
@@ -18,39 +21,773 @@ namespace dd99::wayland
         : m_data_ptr{new data_t, [](data_t * ptr){ return delete ptr; }}
     { }
 
+    engine::~engine()
+    {
+        // moved-from engines have no data
+        if (!m_data_ptr) return;
+
+        // pooled objects are destroyed while the engine can still detach them
+        for (auto block : m_data_ptr->m_object_pools.allocated_blocks())
+            destroy_pooled(*static_cast<proto::interface *>(block));
+    }
+
+    namespace
+    {
+        constexpr auto hdr_size = sizeof(object_id_t) + sizeof(message_size_t) + sizeof(opcode_t);
+
+        // object of an incoming event, with the tables of its interface
+        // the object is null for destroyed (zombie) and unknown objects
+        struct event_target
+        {
+            proto::interface * object = nullptr;
+            std::span<const proto::event_dispatch_fn> dispatchers{};
+            std::span<const std::uint8_t> fd_counts{};
+            std::span<const std::string_view> signatures{};     // used by `input_validation::checked` and to queue events
+            std::span<const proto::event_coalescing> coalescing{};
+            event_queue * queue = nullptr;
+            event_mask_t ignored_events = 0;
+            bool is_known = false;                              // false for ids that are not (or no longer) allocated
+        };
+
+        event_target find_event_target(detail::engine_data & data, object_id_t id)
+        {
+            const auto slot = data.find_object_slot(id);
+            if (slot == nullptr || slot->descriptor == nullptr) return {};
+            const auto & tables = *slot->descriptor;
+            return {slot->object, tables.event_dispatchers, tables.event_fd_counts, tables.event_signatures, tables.event_coalescing_rules, slot->queue, slot->ignored_events, true};
+        }
+
+        // header of a complete message found by the pre-scan
+        struct message_header
+        {
+            std::size_t offset;
+            object_id_t id;
+            message_size_t size;
+            opcode_t code;
+        };
+
+        // messages pre-scanned (and dispatched) per round
+        constexpr std::size_t prescan_batch_size = 64;
+
+        message_header load_header(std::span<const char> data, std::size_t offset = 0)
+        {
+            std::uint32_t words[2];
+            std::memcpy(words, data.data() + offset, sizeof(words));
+            return {
+                .offset = offset,
+                .id = words[0],
+                .size = static_cast<message_size_t>(words[1] >> 16),
+                .code = static_cast<opcode_t>(words[1] & ((1 << 16) - 1)),
+            };
+        }
+
+        // Walks the data once and records the headers of the complete messages (up to `headers.size()`).
+        // Stops at a partial message, and at a size smaller than the header (it would never complete).
+        // @RETURN: number of headers recorded
+        std::size_t prescan_messages(std::span<const char> data, std::span<message_header> headers)
+        {
+            std::size_t count = 0;
+            std::size_t offset = 0;
+
+            while (count < headers.size() && data.size() - offset >= hdr_size)
+            {
+                const auto header = load_header(data, offset);
+                if (header.size < hdr_size || data.size() - offset < header.size) break;
+
+                headers[count++] = header;
+                offset += header.size;
+            }
+
+            return count;
+        }
+
+        // Prefetches the targets of the messages after `current`, one stage per message ahead:
+        // the slot of the third one, the object of the second one and the vtable of the next one.
+        // Each stage reads memory fetched by the previous one. Handlers may bind and unbind objects,
+        // so slots are looked up again at every step (prefetching a stale address is harmless).
+        void prefetch_event_targets(detail::engine_data & data, std::span<const message_header> headers, std::size_t current)
+        {
+            if (current + 3 < headers.size()) __builtin_prefetch(data.find_object_slot(headers[current + 3].id));
+
+            if (current + 2 < headers.size())
+            {
+                auto slot = data.find_object_slot(headers[current + 2].id);
+                if (slot != nullptr) __builtin_prefetch(slot->object);
+            }
+
+            if (current + 1 < headers.size())
+            {
+                auto slot = data.find_object_slot(headers[current + 1].id);
+                if (slot != nullptr && slot->object != nullptr) __builtin_prefetch(*reinterpret_cast<void * const *>(slot->object));
+            }
+        }
+
+        // throws for a message size smaller than the header
+        void check_message_size(std::span<const char> data)
+        {
+            const auto header = load_header(data);
+            if (header.size < hdr_size) [[unlikely]] throw protocol_error{"message size is smaller than its header", header.id, header.code};
+        }
+
+        // the header checks failed: find out which one
+        [[noreturn]] void throw_malformed_header(const event_target & target, object_id_t id, message_size_t msg_size, opcode_t code)
+        {
+            if (msg_size % sizeof(std::uint32_t) != 0) throw protocol_error{"message size is not a multiple of 32 bits", id, code};
+            if (!target.is_known) throw protocol_error{"event for an unknown object", id, code};
+            throw protocol_error{"invalid event opcode", id, code};
+        }
+
+        // checks the arguments of a message against the wire signature of its event
+        // @RETURN: nullptr when the message is well-formed, otherwise what is wrong with it
+        const char * check_message_arguments(std::string_view signature, std::span<const char> message)
+        {
+            constexpr auto word_size = sizeof(std::uint32_t);
+
+            // plain 32-bit arguments only move the offset. The offset is checked before anything is read, and at the end
+            std::size_t offset = hdr_size;
+            bool is_nullable = false;
+
+            auto load_word = [&](std::uint32_t & word)
+            {
+                if (offset > message.size() || message.size() - offset < word_size) [[unlikely]] return false;
+                std::memcpy(&word, message.data() + offset, word_size);
+                offset += word_size;
+                return true;
+            };
+
+            for (auto c : signature)
+            {
+                std::uint32_t word;
+                switch (c)
+                {
+                    case '?': is_nullable = true; continue;
+                    case 'h': continue; // file descriptors are not part of the message data
+
+                    case 'o':
+                    case 'n':
+                        if (!load_word(word)) [[unlikely]] return "message is too short for its arguments";
+                        if (word == 0 && (c == 'n' || !is_nullable)) [[unlikely]] return "null object for a non-nullable argument";
+                        break;
+
+                    case 's':
+                    case 'a':
+                    {
+                        if (!load_word(word)) [[unlikely]] return "message is too short for its arguments";
+                        if (c == 's' && word == 0)
+                        {
+                            if (!is_nullable) [[unlikely]] return "null string for a non-nullable argument";
+                            break;
+                        }
+
+                        const auto padded_size = (std::size_t{word} + word_size - 1) & ~(word_size - 1);
+                        if (message.size() - offset < padded_size) [[unlikely]] return "string or array exceeds the message";
+                        if (c == 's' && message[offset + word - 1] != '\0') [[unlikely]] return "string is not null-terminated";
+                        offset += padded_size;
+                    } break;
+
+                    default: offset += word_size; break;
+                }
+
+                is_nullable = false;
+            }
+
+            if (offset != message.size()) [[unlikely]] return "message size does not match its arguments";
+            return nullptr;
+        }
+
+        std::uint32_t load_argument(std::span<const char> message, std::size_t offset)
+        {
+            std::uint32_t word;
+            std::memcpy(&word, message.data() + offset, sizeof(word));
+            return word;
+        }
+
+        // the arguments named by the rule must be in the message (trusted input is not checked against the signatures)
+        bool is_coalescable(const proto::event_coalescing & rule, std::span<const char> message, std::size_t fd_count)
+        {
+            using rule_t = proto::event_coalescing;
+            const auto fits = [&](std::size_t offset){ return offset + sizeof(std::uint32_t) <= message.size(); };
+            return (rule.mode != rule_t::mode_t::none)
+                && (fd_count == 0)
+                && (message.size() <= detail::coalesced_event::max_size)
+                && (rule.key_offset == rule_t::no_key || fits(rule.key_offset))
+                && (rule.mode != rule_t::mode_t::sum || fits(rule.sum_offset));
+        }
+
+        // Holds back an event. A repeated event (same object, opcode and key) is merged into the one held back,
+        // which keeps its place in the list.
+        void coalesce_event(detail::engine_data & data, const message_header & header, std::span<const char> message, const proto::event_coalescing & rule)
+        {
+            using rule_t = proto::event_coalescing;
+            const std::uint32_t key = (rule.key_offset != rule_t::no_key) ? load_argument(message, rule.key_offset) : 0;
+
+            auto & events = data.m_coalesced_events;
+            auto it = std::ranges::find_if(events, [&](const auto & event){ return event.id == header.id && event.code == header.code && event.key == key; });
+            if (it == events.end())
+            {
+                auto & event = events.emplace_back(detail::coalesced_event{.id = header.id, .code = header.code, .key = key, .size = header.size, .message = {}});
+                std::memcpy(event.message, message.data(), message.size());
+                return;
+            }
+
+            // signed arguments (int and fixed) are summed in two's complement
+            std::uint32_t sum = 0;
+            if (rule.mode == rule_t::mode_t::sum) sum = load_argument({it->message, it->size}, rule.sum_offset) + load_argument(message, rule.sum_offset);
+
+            it->size = header.size;
+            std::memcpy(it->message, message.data(), message.size());
+            if (rule.mode == rule_t::mode_t::sum) std::memcpy(it->message + rule.sum_offset, &sum, sizeof(sum));
+
+            ++data.m_coalesced_event_count;
+        }
+
+        // Objects of the `object` arguments of an event, in order: what its decoder would look up in the engine.
+        // Events copied to an event queue carry them, so they are dispatched without reading the engine.
+        // Strings and arrays are skipped using their size (trusted input is not checked against the signatures).
+        std::span<proto::interface * const> find_object_arguments(detail::engine_data & data, const event_target & target, opcode_t code, std::span<const char> message)
+        {
+            constexpr auto word_size = sizeof(std::uint32_t);
+            auto & objects = data.m_queued_object_arguments;
+            objects.clear();
+
+            const auto signature = (code < target.signatures.size()) ? target.signatures[code] : std::string_view{};
+            std::size_t offset = hdr_size;
+            for (auto c : signature)
+            {
+                if (c == '?' || c == 'h') continue;
+                if (message.size() - offset < word_size) [[unlikely]] break;
+
+                const auto word = load_argument(message, offset);
+                offset += word_size;
+                if (c == 'o')
+                {
+                    auto slot = data.find_object_slot(word);
+                    objects.push_back(slot ? slot->object : nullptr);
+                }
+                else if (c == 's' || c == 'a') offset += std::min((std::size_t{word} + word_size - 1) & ~(word_size - 1), message.size() - offset);
+            }
+
+            return objects;
+        }
+    }
+
+
+    template <input_validation Validation>
     std::size_t engine::process_input(std::span<const char> data)
     {
+        auto & engine_data = *m_data_ptr;
         std::size_t consumed = 0;
 
-        // process one message per cycle
-        // stop when there's not enough data to complete a message
+        // Messages are processed in rounds:
+        // the pre-scan finds the boundaries of the complete messages, then they are dispatched in order.
+        // While a message is dispatched, the objects of the next ones are prefetched.
         for(;;)
         {
-            const auto available_data = data.size();
-            constexpr auto hdr_size = sizeof(object_id_t) + sizeof(message_size_t) + sizeof(opcode_t);
+            message_header headers[prescan_batch_size];
+            const auto count = prescan_messages(data, headers);
+
+            if (count == 0)
+            {
+                // the pre-scan also stops at a size smaller than the header
+                if constexpr (Validation == input_validation::checked)
+                {
+                    if (data.size() >= hdr_size) [[unlikely]] check_message_size(data);
+                }
+                else assert(data.size() < hdr_size || load_header(data).size >= hdr_size);
+                break;
+            }
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                prefetch_event_targets(engine_data, std::span{headers}.first(count), i);
+
+                const auto & header = headers[i];
+                const auto message = data.subspan(header.offset, header.size);
+                const auto target = find_event_target(engine_data, header.id);
+
+                // one branch for all the header checks (the object must exist, even if it was destroyed)
+                if constexpr (Validation == input_validation::checked)
+                {
+                    const bool is_malformed = (header.size % sizeof(std::uint32_t) != 0)
+                                            | !target.is_known
+                                            | (header.code >= target.signatures.size());
+                    if (is_malformed) [[unlikely]] throw_malformed_header(target, header.id, header.size, header.code);
+
+                    if (auto error = check_message_arguments(target.signatures[header.code], message)) [[unlikely]]
+                        throw protocol_error{error, header.id, header.code};
+                }
+                // the file descriptors of an event for an unknown object can not be told apart from those of the next events
+                else if (!target.is_known) [[unlikely]] throw protocol_error{"event for an unknown object", header.id, header.code};
+
+                // file descriptors arrive with (or before) the message that carries them
+                const std::size_t fd_count = (header.code < target.fd_counts.size()) ? target.fd_counts[header.code] : 0;
+                if (fd_count > engine_data.m_input_fds.size())
+                {
+                    flush_coalesced_events();
+                    return consumed;
+                }
+
+                consumed += header.size;
+
+                // events are dispatched through the decoder table of the object (one indirect call per event)
+                // event handlers take their file descriptors with `take_input_fd`
+                // events for destroyed objects (and unknown opcodes) are discarded, along with their file descriptors
+                // so are the events ignored by the object (see `set_ignored_events`), which are not decoded at all
+                // events of objects assigned to an event queue are copied to that queue
+                // when coalescing is enabled, coalesced events are held back until the next event that is not (see `set_event_coalescing`)
+                const bool is_ignored = (header.code < event_mask_bits) && ((target.ignored_events >> header.code) & 1);
+                const bool is_dispatchable = target.object && (header.code < target.dispatchers.size()) && !is_ignored;
+                const bool is_coalesced = engine_data.m_event_coalescing_enabled && is_dispatchable && !target.queue
+                                       && (header.code < target.coalescing.size()) && is_coalescable(target.coalescing[header.code], message, fd_count);
+
+                if (!is_dispatchable) [[unlikely]] for (std::size_t j = 0; j < fd_count; ++j) ::close(engine_data.m_input_fds.pop());
+                else if (is_coalesced) [[unlikely]] coalesce_event(engine_data, header, message, target.coalescing[header.code]);
+                else
+                {
+                    flush_coalesced_events();
+                    if (!target.queue) [[likely]] target.dispatchers[header.code](*target.object, message);
+                    else
+                    {
+                        const auto objects = find_object_arguments(engine_data, target, header.code, message);
+                        target.queue->push(*target.object, target.dispatchers[header.code], message, objects, engine_data.m_input_fds, fd_count);
+                    }
+                }
+            }
+
+            data = data.subspan(headers[count - 1].offset + headers[count - 1].size);
+        }
+
+        flush_coalesced_events();
+        return consumed;
+    }
+
+    std::size_t engine::count_messages(std::span<const char> data)
+    {
+        std::size_t total = 0;
+        for (;;)
+        {
+            message_header headers[prescan_batch_size];
+            const auto count = prescan_messages(data, headers);
+            total += count;
+            if (count < prescan_batch_size) return total;
+            data = data.subspan(headers[count - 1].offset + headers[count - 1].size);
+        }
+    }
 
-            if (available_data < hdr_size) break;
+    template <input_validation Validation>
+    std::size_t engine::process_input(std::span<const char> data, std::span<const int> fds)
+    {
+        push_input_fds(fds);
+        return process_input<Validation>(data);
+    }
 
-            const object_id_t msg_obj_id = *reinterpret_cast<const std::uint32_t *>(data.data());
-            const message_size_t msg_size = static_cast<std::uint16_t>((*(reinterpret_cast<const std::uint32_t *>(data.data()) + 1)) >> 16);
-            const opcode_t code [[maybe_unused]] = static_cast<std::uint16_t>((*(reinterpret_cast<const std::uint32_t *>(data.data()) + 1)) & ((1<<16)-1));
-            
-            if (available_data < msg_size) break;
-            consumed += msg_size;
-            
-            m_data_ptr->m_client_object_map[msg_obj_id]->parse_and_dispatch_event(data);
+    void engine::push_input_fds(std::span<const int> fds)
+    {
+        for (auto fd : fds) m_data_ptr->m_input_fds.push(fd);
+    }
 
-            data = data.subspan(msg_size);
+    int engine::take_input_fd()
+    {
+        // event dispatched by an event queue
+        if (auto queued_fds = detail::t_queued_input_fds) [[unlikely]]
+        {
+            assert(!queued_fds->empty());
+            auto fd = queued_fds->front();
+            *queued_fds = queued_fds->subspan(1);
+            return fd;
+        }
+
+        // `process_input` does not dispatch a message before its file descriptors are queued
+        assert(!m_data_ptr->m_input_fds.empty());
+        return m_data_ptr->m_input_fds.pop();
+    }
+
+
+    template <input_validation Validation>
+    std::size_t engine::process_input(std::span<const ::iovec> data)
+    {
+        auto & bounce_buffer = m_data_ptr->m_input_bounce_buffer;
+        std::size_t consumed = 0;
+        std::span<const char> segment{};
+        std::size_t next_segment = 0;
+
+        auto load_next_segment = [&]()
+        {
+            const auto & x = data[next_segment++];
+            segment = {static_cast<const char *>(x.iov_base), x.iov_len};
+        };
+
+        // size of the message starting at `message`, `hdr_size` while its header is incomplete
+        auto message_size = [](std::span<const char> message) -> std::size_t
+        {
+            if (message.size() < hdr_size) return hdr_size;
+            std::uint32_t size_and_opcode;
+            std::memcpy(&size_and_opcode, message.data() + sizeof(object_id_t), sizeof(size_and_opcode));
+            return std::max<std::size_t>(size_and_opcode >> 16, hdr_size);
+        };
+
+        for (;;)
+        {
+            // dispatch the complete messages of the current segment in place
+            auto n = process_input<Validation>(segment);
+            consumed += n;
+            segment = segment.subspan(n);
+
+            // no more data: what is left is a partial message
+            if (next_segment == data.size()) break;
+
+            if (segment.empty())
+            {
+                load_next_segment();
+                continue;
+            }
+
+            // stopped on a complete message (its file descriptors have not arrived yet)
+            if (segment.size() >= message_size(segment)) break;
+
+            // the last message of this segment continues in the next one(s): complete it in the bounce buffer
+            bounce_buffer.assign(segment.begin(), segment.end());
+            segment = {};
+
+            for (;;)
+            {
+                auto msg_size = message_size(bounce_buffer);
+                if (bounce_buffer.size() == msg_size) break;
+
+                if (segment.empty())
+                {
+                    // still incomplete, not consumed
+                    if (next_segment == data.size()) return consumed;
+                    load_next_segment();
+                    continue;
+                }
+
+                auto count = std::min(msg_size - bounce_buffer.size(), segment.size());
+                bounce_buffer.insert(bounce_buffer.end(), segment.begin(), segment.begin() + static_cast<std::ptrdiff_t>(count));
+                segment = segment.subspan(count);
+            }
+
+            // not dispatched (its file descriptors have not arrived yet)
+            auto bounce_consumed = process_input<Validation>(bounce_buffer);
+            if (bounce_consumed == 0) break;
+            consumed += bounce_consumed;
         }
 
         return consumed;
     }
 
+    template std::size_t engine::process_input<input_validation::trusted>(std::span<const char>);
+    template std::size_t engine::process_input<input_validation::checked>(std::span<const char>);
+    template std::size_t engine::process_input<input_validation::trusted>(std::span<const char>, std::span<const int>);
+    template std::size_t engine::process_input<input_validation::checked>(std::span<const char>, std::span<const int>);
+    template std::size_t engine::process_input<input_validation::trusted>(std::span<const ::iovec>);
+    template std::size_t engine::process_input<input_validation::checked>(std::span<const ::iovec>);
+
+
+    void engine::flush_coalesced_events()
+    {
+        auto & events = m_data_ptr->m_coalesced_events;
+        if (events.empty()) [[likely]] return;
+
+        // the list is cleared even if a handler throws
+        struct clear_guard
+        {
+            std::vector<detail::coalesced_event> & events;
+            ~clear_guard() { events.clear(); }
+        } guard{events};
+
+        for (std::size_t i = 0; i < events.size(); ++i)
+        {
+            // copied: a handler may process input (which reuses the list)
+            // objects are looked up again: a handler may destroy them
+            const auto event = events[i];
+            const auto target = find_event_target(*m_data_ptr, event.id);
+            if (!target.object || event.code >= target.dispatchers.size()) continue;
+
+            const std::span<const char> message{event.message, event.size};
+            if (!target.queue) [[likely]] target.dispatchers[event.code](*target.object, message);
+            else
+            {
+                const auto objects = find_object_arguments(*m_data_ptr, target, event.code, message);
+                target.queue->push(*target.object, target.dispatchers[event.code], message, objects, m_data_ptr->m_input_fds, 0);
+            }
+        }
+    }
+
+
+    void engine::begin_batch()
+    {
+        auto & data = *m_data_ptr;
+        if (data.m_batch_depth++ != 0) return;
+
+        data.m_batch_saved_buffering_enabled = data.m_output_buffering_enabled;
+        data.m_batch_saved_flush_threshold = data.m_flush_threshold;
+
+        // collect everything, flush only at the end
+        data.m_output_buffering_enabled = true;
+        data.m_flush_threshold = 0;
+    }
+
+    void engine::end_batch(bool flush_output)
+    {
+        auto & data = *m_data_ptr;
+        assert(data.m_batch_depth > 0);
+        if (--data.m_batch_depth != 0) return;
+
+        data.m_output_buffering_enabled = data.m_batch_saved_buffering_enabled;
+        data.m_flush_threshold = data.m_batch_saved_flush_threshold;
+        if (flush_output) flush();
+    }
+
+
+    void engine::enable_output_buffering(std::size_t flush_threshold)
+    {
+        auto & data = *m_data_ptr;
+
+        // inside a batch, the change takes effect when the batch ends
+        if (data.m_batch_depth != 0)
+        {
+            data.m_batch_saved_buffering_enabled = true;
+            data.m_batch_saved_flush_threshold = flush_threshold;
+            return;
+        }
+
+        data.m_output_buffering_enabled = true;
+        data.m_flush_threshold = flush_threshold;
+    }
+
+    void engine::disable_output_buffering()
+    {
+        // inside a batch, the change takes effect when the batch ends
+        if (m_data_ptr->m_batch_depth != 0)
+        {
+            m_data_ptr->m_batch_saved_buffering_enabled = false;
+            return;
+        }
+
+        flush();
+        m_data_ptr->m_output_buffering_enabled = false;
+    }
+
+    bool engine::is_output_buffering_enabled() const
+    {
+        return m_data_ptr->m_output_buffering_enabled;
+    }
+
+    std::size_t engine::flush()
+    {
+        auto & buffer = m_data_ptr->m_output_buffer;
+        if (buffer.empty()) return 0;
+
+        const auto max_fds = m_data_ptr->m_max_fds_per_flush;
+        std::size_t total = 0;
+
+        // data is handed over in chunks that carry at most `max_fds` file descriptors
+        // each chunk ends with the message that carries its last file descriptor (or with the buffer)
+        while (!buffer.empty())
+        {
+            auto data = buffer.data();
+            auto fds = buffer.fds();
+
+            if (fds.size() > max_fds)
+            {
+                fds = fds.first(max_fds);
+                data = data.first(buffer.data_size_for_fds(max_fds));
+            }
+
+            const ::iovec iov {
+                .iov_base = const_cast<char *>(data.data()),
+                .iov_len = data.size(),
+            };
+
+            auto n = on_flush({&iov, 1}, fds);
+            assert(n <= data.size());
+
+            if (n > 0) buffer.consume_fds(fds.size());
+            buffer.consume(n);
+            total += n;
+
+            // stop when the receiver does not accept everything (i.e. would block)
+            if (n < data.size() || n == 0) break;
+        }
+
+        // update counters
+        auto & stats = m_data_ptr->m_output_statistics;
+        auto messages = buffer.take_message_count();
+        stats.flush_count++;
+        stats.total_bytes += total;
+        stats.total_messages += messages;
+        stats.last_flush_bytes = total;
+        stats.last_flush_messages = messages;
+        stats.max_flush_bytes = std::max(stats.max_flush_bytes, total);
+        stats.max_flush_messages = std::max(stats.max_flush_messages, messages);
+
+        check_output_drained();
+
+        return total;
+    }
+
+    void engine::set_max_fds_per_flush(std::size_t max_fds)
+    {
+        assert(max_fds > 0);
+        m_data_ptr->m_max_fds_per_flush = max_fds;
+    }
+
+    std::size_t engine::pending_output_fds() const
+    {
+        return m_data_ptr->m_output_buffer.fds_size();
+    }
+
+    std::size_t engine::pending_output_size() const
+    {
+        return m_data_ptr->m_output_buffer.size();
+    }
+
+    const output_statistics & engine::get_output_statistics() const
+    {
+        return m_data_ptr->m_output_statistics;
+    }
+
+    void engine::reset_output_statistics()
+    {
+        m_data_ptr->m_output_statistics = {};
+    }
+
+    void engine::set_event_coalescing(bool enabled)
+    {
+        m_data_ptr->m_event_coalescing_enabled = enabled;
+    }
+
+    bool engine::get_event_coalescing() const
+    {
+        return m_data_ptr->m_event_coalescing_enabled;
+    }
+
+    std::size_t engine::get_coalesced_event_count() const
+    {
+        return m_data_ptr->m_coalesced_event_count;
+    }
+
+    void engine::reset_coalesced_event_count()
+    {
+        m_data_ptr->m_coalesced_event_count = 0;
+    }
+
+    void engine::set_output_watermarks(const output_watermarks & watermarks)
+    {
+        assert(watermarks.low_bytes <= watermarks.high_bytes || watermarks.high_bytes == 0);
+        assert(watermarks.low_fds <= watermarks.high_fds || watermarks.high_fds == 0);
+        m_data_ptr->m_output_watermarks = watermarks;
+    }
+
+    const output_watermarks & engine::get_output_watermarks() const
+    {
+        return m_data_ptr->m_output_watermarks;
+    }
+
+    bool engine::would_block() const
+    {
+        return m_data_ptr->m_output_above_high_watermark;
+    }
+
+    void engine::check_output_high_watermark()
+    {
+        auto & data = *m_data_ptr;
+        if (data.m_output_above_high_watermark) return;
+
+        const auto & watermarks = data.m_output_watermarks;
+        const auto & buffer = data.m_output_buffer;
+        if ((watermarks.high_bytes != 0 && buffer.size() >= watermarks.high_bytes)
+         || (watermarks.high_fds != 0 && buffer.fds_size() >= watermarks.high_fds))
+        {
+            data.m_output_above_high_watermark = true;
+            on_output_high_watermark();
+        }
+    }
+
+    void engine::check_output_drained()
+    {
+        auto & data = *m_data_ptr;
+        if (!data.m_output_above_high_watermark) return;
+
+        const auto & watermarks = data.m_output_watermarks;
+        const auto & buffer = data.m_output_buffer;
+        if (buffer.size() <= watermarks.low_bytes && buffer.fds_size() <= watermarks.low_fds)
+        {
+            data.m_output_above_high_watermark = false;
+            on_output_drained();
+        }
+    }
+
+    std::size_t engine::on_flush(std::span<const ::iovec> data, std::span<int> fds)
+    {
+        std::size_t n = 0;
+        for (const auto & x : data)
+        {
+            on_output({static_cast<const char *>(x.iov_base), x.iov_len}, std::exchange(fds, {}));
+            n += x.iov_len;
+        }
+        return n;
+    }
+
+    void engine::on_output_iov(std::span<const ::iovec> data, std::span<int> fds)
+    {
+        auto & buffer = m_data_ptr->m_gather_buffer;
+        buffer.clear();
+        for (const auto & x : data)
+        {
+            auto p = static_cast<const char *>(x.iov_base);
+            buffer.insert(buffer.end(), p, p + x.iov_len);
+        }
+        on_output(buffer, fds);
+    }
+
+    void engine::write_message(std::span<const char> data, std::span<int> fds)
+    {
+        auto & buffer = m_data_ptr->m_output_buffer;
+
+        // without buffering, output still pending (i.e. not accepted by the last flush) must go first
+        if (!m_data_ptr->m_output_buffering_enabled && buffer.empty())
+        {
+            on_output(data, fds);
+            return;
+        }
+
+        buffer.append(data, fds);
+
+        auto threshold = m_data_ptr->m_output_buffering_enabled ? m_data_ptr->m_flush_threshold : 1;
+        if (threshold != 0 && buffer.size() >= threshold) flush();
+
+        check_output_high_watermark();
+    }
+
+    void engine::write_message(std::span<const ::iovec> data, std::span<int> fds)
+    {
+        auto & buffer = m_data_ptr->m_output_buffer;
+
+        // without buffering, output still pending (i.e. not accepted by the last flush) must go first
+        if (!m_data_ptr->m_output_buffering_enabled && buffer.empty())
+        {
+            on_output_iov(data, fds);
+            return;
+        }
+
+        buffer.append(data, fds);
+
+        auto threshold = m_data_ptr->m_output_buffering_enabled ? m_data_ptr->m_flush_threshold : 1;
+        if (threshold != 0 && buffer.size() >= threshold) flush();
+
+        check_output_high_watermark();
+    }
+
 
     object_id_t engine::bind_interface(proto::interface & interface_instance, version_t version)
     {
         // inserting into the object map allocates an object id (the key of the map)
-        auto it = m_data_ptr->m_client_object_map.insert(&interface_instance);
+        auto it = m_data_ptr->m_client_object_map.insert({
+            .object = &interface_instance,
+            .descriptor = &interface_instance.get_interface_descriptor(),
+        });
         // get the new allocated object id
         auto new_object_id = it.get_key();
 
@@ -59,32 +796,130 @@ namespace dd99::wayland
         return new_object_id;
     }
 
+    void engine::bind_interface(proto::interface & interface_instance, version_t version, object_id_t id)
+    {
+        // server ids are allocated by the server. A reused id replaces a zombie
+        assert(id >= detail::engine_data::server_object_id_base);
+        m_data_ptr->m_server_object_map.insert_at(id, {
+            .object = &interface_instance,
+            .descriptor = &interface_instance.get_interface_descriptor(),
+        });
+
+        interface_instance.m_object_id = id;
+        interface_instance.m_version = version;
+    }
+
+    object_id_t engine::bind_interface(proto::interface & interface_instance, version_t version, const proto::interface & parent)
+    {
+        auto new_object_id = bind_interface(interface_instance, version);
+
+        auto parent_slot = m_data_ptr->find_object_slot(parent.m_object_id);
+        if (parent_slot != nullptr && parent_slot->object == &parent)
+            m_data_ptr->m_client_object_map[new_object_id].queue = parent_slot->queue;
+
+        return new_object_id;
+    }
+
+    void engine::set_interface_queue(proto::interface & interface_instance, event_queue * queue)
+    {
+        auto slot = m_data_ptr->find_object_slot(interface_instance.m_object_id);
+        assert(slot != nullptr && slot->object == &interface_instance); // the object must be bound
+        slot->queue = queue;
+    }
+
+    void engine::set_interface_ignored_events(proto::interface & interface_instance, event_mask_t mask)
+    {
+        auto slot = m_data_ptr->find_object_slot(interface_instance.m_object_id);
+        assert(slot != nullptr && slot->object == &interface_instance); // the object must be bound
+        slot->ignored_events = mask;
+    }
+
+    void engine::add_queue(event_queue & queue)
+    {
+        m_data_ptr->m_event_queues.push_back(&queue);
+    }
+
+    void engine::remove_queue(event_queue & queue)
+    {
+        std::erase(m_data_ptr->m_event_queues, &queue);
+        for (auto & slot : m_data_ptr->m_client_object_map) if (slot.queue == &queue) slot.queue = nullptr;
+        for (auto & slot : m_data_ptr->m_server_object_map) if (slot.queue == &queue) slot.queue = nullptr;
+    }
+
     void engine::unbind_interface(object_id_t id)
     {
-        if (id >= detail::engine_data::server_object_id_base)
+        auto slot = m_data_ptr->find_object_slot(id);
+        if (slot == nullptr) return;
+
+        // a pooled object still alive goes with its id (i.e. a `wl_callback` after its `done` event)
+        if (slot->object && m_data_ptr->m_object_pools.owns(slot->object))
         {
-            m_data_ptr->m_server_object_map.erase(id);
+            // its destructor may bind or unbind other objects (slots may move): the slot is looked up again
+            destroy_pooled(*slot->object);
+            slot = m_data_ptr->find_object_slot(id);
+            if (slot == nullptr) return;
         }
-        else
+
+        // the object (if still alive) no longer has an id
+        if (slot->object) slot->object->m_object_id = 0;
+
+        // erasing may shrink the map (moving the slots): `slot` is not used past this point
+        if (id >= detail::engine_data::server_object_id_base) m_data_ptr->m_server_object_map.reset(id);
+        else m_data_ptr->m_client_object_map.erase(id);
+    }
+
+    void engine::release_interface(proto::interface & interface_instance)
+    {
+        if (m_data_ptr->m_object_pools.owns(&interface_instance)) destroy_pooled(interface_instance);
+    }
+
+    void * engine::allocate_pooled(std::size_t size)
+    {
+        return m_data_ptr->m_object_pools.allocate(size);
+    }
+
+    void engine::deallocate_pooled(void * memory)
+    {
+        m_data_ptr->m_object_pools.deallocate(memory);
+    }
+
+    void engine::destroy_pooled(proto::interface & interface_instance)
+    {
+        // the destructor detaches the object: its id stays reserved until the server deletes it
+        void * memory = &interface_instance;
+        std::destroy_at(&interface_instance);
+        deallocate_pooled(memory);
+    }
+
+    void engine::detach_interface(proto::interface & interface_instance)
+    {
+        // the id stays reserved until the server confirms the deletion or reuses the id (see `object_slot`)
+        auto slot = m_data_ptr->find_object_slot(interface_instance.m_object_id);
+        if (slot == nullptr || slot->object != &interface_instance) return;
+        slot->object = nullptr;
+
+        // events already queued for it are discarded, and the queued events that have it as an argument get nullptr instead
+        for (auto queue : m_data_ptr->m_event_queues) queue->forget(interface_instance);
+    }
+
+    proto::interface * engine::take_object_argument(object_id_t id)
+    {
+        // event dispatched by an event queue
+        if (auto queued_objects = detail::t_queued_object_arguments) [[unlikely]]
         {
-            m_data_ptr->m_client_object_map.erase(id);
+            assert(!queued_objects->empty());
+            auto object = queued_objects->front();
+            *queued_objects = queued_objects->subspan(1);
+            return object;
         }
+
+        return get_interface(id);
     }
 
     proto::interface * engine::get_interface(object_id_t id)
     {
-        if (id >= detail::engine_data::server_object_id_base)
-        {
-            auto it = m_data_ptr->m_server_object_map.find(id);
-            if (it == m_data_ptr->m_server_object_map.end()) return nullptr;
-            else return it->second.get();
-        }
-        else
-        {
-            if (m_data_ptr->m_client_object_map.is_in_range(id))
-                return m_data_ptr->m_client_object_map[id];
-            else return nullptr;
-        }
+        auto slot = m_data_ptr->find_object_slot(id);
+        return slot ? slot->object : nullptr;
     }
 
 }
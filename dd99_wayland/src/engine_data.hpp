@@ -1,16 +1,61 @@
 #pragma once
 
+#include <dd99/wayland/event_queue.hpp>
 #include <dd99/wayland/interface.hpp>
 #include "dd99/wayland/types.hpp"
+#include <dd99/wayland/scm_rights.hpp>
+#include "fd_ring.hpp"
 #include "object_map.hpp"
+#include "output_buffer.hpp"
+#include "slab_pools.hpp"
 
-#include <map>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
 
 
 
 namespace dd99::wayland::detail
 {
 
+        // Entry of the object maps.
+        // When its object is destroyed, a slot stays reserved (zombie) until the server confirms the deletion (`delete_id`),
+        // or until the server reuses the id (server-allocated ids).
+        // Events still in flight for a zombie are discarded, but the file descriptors they carry must be closed,
+        // so the slot keeps the event tables of its interface: a zombie is a slot with a descriptor and no object.
+        struct object_slot
+        {
+            proto::interface * object = nullptr;
+            const proto::interface_descriptor * descriptor = nullptr;   // event tables (null for free slots)
+            event_queue * queue = nullptr;          // null for the default queue (dispatched by `process_input`)
+            event_mask_t ignored_events = 0;        // events discarded by `process_input`
+
+            explicit operator bool() const { return descriptor != nullptr; }
+        };
+        static_assert(sizeof(object_slot) <= 32);
+
+        // event held back by the coalescing stage of `process_input` (see `engine::set_event_coalescing`)
+        struct coalesced_event
+        {
+            // only small events are coalesced (pointer and touch motion and axis events are at most 28 bytes)
+            static constexpr std::size_t max_size = 32;
+
+            object_id_t id;
+            opcode_t code;
+            std::uint32_t key;
+            message_size_t size;
+            alignas(std::uint32_t) char message[max_size];
+        };
+
+        // file descriptors of the events dispatched by an event queue on this thread
+        // `engine::take_input_fd` takes them from here (instead of the engine's queue) while it is set
+        inline thread_local std::span<const int> * t_queued_input_fds = nullptr;
+
+        // object arguments of the event dispatched by an event queue on this thread (looked up when the event was queued)
+        // `engine::take_object_argument` takes them from here (instead of looking them up) while it is set
+        inline thread_local std::span<proto::interface * const> * t_queued_object_arguments = nullptr;
+
         // the data used by the engine
         // this structure is used via PIMPL
         // Object maps used for translating object-id to object instance
@@ -19,12 +64,53 @@ namespace dd99::wayland::detail
             static constexpr object_id_t client_object_id_base = 1;
             static constexpr object_id_t server_object_id_base = 0xFF000000;
 
-            using local_obj_map_type = object_map<proto::interface, object_id_t, client_object_id_base>;
-            // using remote_obj_map_type = object_map<proto::interface, object_id_t, server_object_id_base>;
-            using remote_obj_map_type = std::map<object_id_t, std::unique_ptr<proto::interface>>;
+            using local_obj_map_type = object_map<object_slot, object_id_t, client_object_id_base>;
+            using remote_obj_map_type = object_map<object_slot, object_id_t, server_object_id_base>;
 
             local_obj_map_type m_client_object_map{};
-            remote_obj_map_type m_server_object_map{};
+            remote_obj_map_type m_server_object_map{};     // ids allocated by the server (stored with `insert_at`)
+
+            // slot of an object id, whichever side allocated it. nullptr when out of range (the slot may be empty)
+            object_slot * find_object_slot(object_id_t id)
+            {
+                return (id >= server_object_id_base) ? m_server_object_map.find(id) : m_client_object_map.find(id);
+            }
+
+            // memory of the objects made by `engine::create`
+            slab_pools m_object_pools{};
+
+            // output buffering (disabled by default)
+            bool m_output_buffering_enabled = false;
+            std::size_t m_flush_threshold = 0;
+            output_buffer m_output_buffer{};
+            std::size_t m_max_fds_per_flush = max_fds_per_message;
+            output_statistics m_output_statistics{};
+            output_watermarks m_output_watermarks{};
+            bool m_output_above_high_watermark = false;
+
+            // request batching: buffering settings to restore when the outermost batch ends
+            std::size_t m_batch_depth = 0;
+            bool m_batch_saved_buffering_enabled = false;
+            std::size_t m_batch_saved_flush_threshold = 0;
+
+            // event coalescing (disabled by default)
+            bool m_event_coalescing_enabled = false;
+            std::vector<coalesced_event> m_coalesced_events{};     // held back until the next event that is not coalesced
+            std::size_t m_coalesced_event_count = 0;
+
+            // received file descriptors, not yet taken by event handlers
+            fd_ring m_input_fds{};
+
+            // event queues of the engine (objects destroyed are forgotten by their queued events)
+            std::vector<event_queue *> m_event_queues{};
+            // object arguments of the event being queued
+            std::vector<proto::interface *> m_queued_object_arguments{};
+
+            // input messages that straddle `iovec` segments are gathered here
+            std::vector<char> m_input_bounce_buffer{};
+
+            // reused by the default `on_output_iov` to gather scattered messages
+            std::vector<char> m_gather_buffer{};
         };
 
 }
@@ -0,0 +1,190 @@
+#include <dd99/wayland/event_queue.hpp>
+#include <dd99/wayland/engine.hpp>
+#include <dd99/wayland/interface.hpp>
+#include "engine_data.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include <utility>
+
+
+
+namespace dd99::wayland
+{
+
+    namespace
+    {
+        // size of a queued event (header and message), keeping the next header aligned
+        constexpr std::size_t entry_size(std::size_t header_size, std::size_t message_size, std::size_t alignment)
+        {
+            return (header_size + message_size + alignment - 1) & ~(alignment - 1);
+        }
+
+        // makes `engine::take_input_fd` and `engine::take_object_argument` take the file descriptors
+        // and objects of queued events (on this thread)
+        struct queued_arguments_guard
+        {
+            queued_arguments_guard(std::span<const int> & fds, std::span<proto::interface * const> & objects)
+                : m_previous_fds{std::exchange(detail::t_queued_input_fds, &fds)}
+                , m_previous_objects{std::exchange(detail::t_queued_object_arguments, &objects)}
+            { }
+
+            ~queued_arguments_guard()
+            {
+                detail::t_queued_input_fds = m_previous_fds;
+                detail::t_queued_object_arguments = m_previous_objects;
+            }
+
+            queued_arguments_guard(const queued_arguments_guard &) = delete;
+            queued_arguments_guard & operator=(const queued_arguments_guard &) = delete;
+
+        private:
+            std::span<const int> * m_previous_fds;
+            std::span<proto::interface * const> * m_previous_objects;
+        };
+    }
+
+
+    event_queue::event_queue(engine & eng)
+        : m_engine{eng}
+        , m_mutex{}
+    {
+        m_engine.add_queue(*this);
+    }
+
+    event_queue::~event_queue()
+    {
+        m_engine.remove_queue(*this);
+        close_fds(m_fds);
+    }
+
+
+    std::size_t event_queue::dispatch_pending()
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            if (m_event_count == 0) return 0;
+
+            m_events.swap(m_dispatch_events);
+            m_fds.swap(m_dispatch_fds);
+            m_arguments.swap(m_dispatch_arguments);
+            m_events.clear();
+            m_fds.clear();
+            m_arguments.clear();
+            m_event_count = 0;
+        }
+
+        std::size_t count = 0;
+        std::span<const int> fds{m_dispatch_fds};
+        std::span<proto::interface * const> objects{};
+        queued_arguments_guard arguments_guard{fds, objects};
+
+        // if a handler throws, the events not dispatched yet are dropped: the file descriptors it did not take are closed,
+        // and so are those of the next events
+        struct cleanup_guard
+        {
+            event_queue & queue;
+            std::span<const int> & fds;
+
+            ~cleanup_guard()
+            {
+                close_fds(fds);
+                std::lock_guard lock{queue.m_mutex};
+                queue.m_dispatch_events.clear();
+                queue.m_dispatch_fds.clear();
+                queue.m_dispatch_arguments.clear();
+            }
+        } cleanup{*this, fds};
+
+        for (std::size_t offset = 0, argument_offset = 0;; ++count)
+        {
+            // the header and objects are read again for every event, under the lock:
+            // objects destroyed (by a handler, or by another thread) are forgotten in this batch too
+            event_header header;
+            {
+                std::lock_guard lock{m_mutex};
+                if (offset == m_dispatch_events.size()) break;
+
+                std::memcpy(&header, m_dispatch_events.data() + offset, sizeof(header));
+                const auto arguments = std::span{m_dispatch_arguments}.subspan(argument_offset, header.argument_count);
+                m_event_arguments.assign(arguments.begin(), arguments.end());
+            }
+            const std::span<const char> message{m_dispatch_events.data() + offset + sizeof(header), header.size};
+            offset += entry_size(sizeof(header), header.size, alignof(event_header));
+            argument_offset += header.argument_count;
+
+            // handlers take exactly the file descriptors and objects of their event
+            const auto event_fds = fds.first(header.fd_count);
+            objects = m_event_arguments;
+            if (header.object) [[likely]] header.dispatcher(*header.object, message);
+            else close_fds(event_fds);
+            fds = std::span<const int>{event_fds.data() + event_fds.size(), fds.data() + fds.size()};
+        }
+
+        return count;
+    }
+
+    std::size_t event_queue::size() const
+    {
+        std::lock_guard lock{m_mutex};
+        return m_event_count;
+    }
+
+
+    void event_queue::push(proto::interface & object, proto::event_dispatch_fn dispatcher, std::span<const char> message,
+        std::span<proto::interface * const> arguments, detail::fd_ring & fds, std::size_t fd_count)
+    {
+        const event_header header {
+            .object = &object,
+            .dispatcher = dispatcher,
+            .size = static_cast<std::uint32_t>(message.size()),
+            .fd_count = static_cast<std::uint32_t>(fd_count),
+            .argument_count = static_cast<std::uint32_t>(arguments.size()),
+        };
+
+        std::lock_guard lock{m_mutex};
+
+        const auto offset = m_events.size();
+        m_events.resize(offset + entry_size(sizeof(header), message.size(), alignof(event_header)));
+        std::memcpy(m_events.data() + offset, &header, sizeof(header));
+        std::memcpy(m_events.data() + offset + sizeof(header), message.data(), message.size());
+
+        m_arguments.insert(m_arguments.end(), arguments.begin(), arguments.end());
+        for (std::size_t i = 0; i < fd_count; ++i) m_fds.push_back(fds.pop());
+        ++m_event_count;
+    }
+
+    void event_queue::forget(const proto::interface & object)
+    {
+        // the object may be destroyed by another thread than the one dispatching: the events being dispatched are locked too
+        std::lock_guard lock{m_mutex};
+        forget(m_dispatch_events, m_dispatch_arguments, object);
+        forget(m_events, m_arguments, object);
+    }
+
+    void event_queue::forget(std::vector<char> & events, std::vector<proto::interface *> & arguments, const proto::interface & object)
+    {
+        for (std::size_t offset = 0; offset < events.size();)
+        {
+            event_header header;
+            std::memcpy(&header, events.data() + offset, sizeof(header));
+
+            if (header.object == &object)
+            {
+                header.object = nullptr;
+                std::memcpy(events.data() + offset, &header, sizeof(header));
+            }
+
+            offset += entry_size(sizeof(header), header.size, alignof(event_header));
+        }
+
+        std::ranges::replace(arguments, &object, nullptr);
+    }
+
+    void event_queue::close_fds(std::span<const int> fds)
+    {
+        for (auto fd : fds) ::close(fd);
+    }
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <unistd.h>
+#include <vector>
+
+// private header
+// to be used only in library implementation code
+
+
+
+namespace dd99::wayland::detail
+{
+
+    // FIFO of received file descriptors (owned).
+    // A ring with a power-of-2 capacity: push and pop are constant time and do not allocate,
+    // except when the ring is full (then its capacity is doubled).
+    // File descriptors still queued on destruction are closed.
+    struct fd_ring
+    {
+        static constexpr std::size_t initial_capacity = 128;
+
+        fd_ring() = default;
+        fd_ring(const fd_ring &) = delete;
+        fd_ring & operator=(const fd_ring &) = delete;
+
+        ~fd_ring()
+        {
+            while (!empty()) ::close(pop());
+        }
+
+        void push(int fd)
+        {
+            if (m_size == m_fds.size()) [[unlikely]] grow();
+            m_fds[(m_begin + m_size) & (m_fds.size() - 1)] = fd;
+            ++m_size;
+        }
+
+        int pop()
+        {
+            assert(!empty());
+            auto fd = m_fds[m_begin];
+            m_begin = (m_begin + 1) & (m_fds.size() - 1);
+            --m_size;
+            return fd;
+        }
+
+        std::size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+
+    private:
+        void grow()
+        {
+            std::vector<int> fds(m_fds.size() * 2);
+            for (std::size_t i = 0; i < m_size; ++i) fds[i] = m_fds[(m_begin + i) & (m_fds.size() - 1)];
+            m_fds = std::move(fds);
+            m_begin = 0;
+        }
+
+
+    private:
+        std::vector<int> m_fds = std::vector<int>(initial_capacity); // size is always a power of 2
+        std::size_t m_begin = 0;
+        std::size_t m_size = 0;
+
+        static_assert(std::has_single_bit(initial_capacity));
+    };
+
+}
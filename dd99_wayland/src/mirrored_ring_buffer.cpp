@@ -0,0 +1,53 @@
+#include <dd99/wayland/mirrored_ring_buffer.hpp>
+
+#include <cerrno>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+
+
+namespace dd99::wayland
+{
+
+    mirrored_ring_buffer::mirrored_ring_buffer(std::size_t min_capacity)
+    {
+        const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const auto capacity = (min_capacity + page_size - 1) / page_size * page_size;
+
+        auto fail = [](const char * what, int fd = -1, void * reserved = MAP_FAILED, std::size_t reserved_size = 0)
+        {
+            auto error = errno;
+            if (reserved != MAP_FAILED) ::munmap(reserved, reserved_size);
+            if (fd >= 0) ::close(fd);
+            throw std::system_error{error, std::system_category(), what};
+        };
+
+        int fd = ::memfd_create("dd99-wayland-ring", MFD_CLOEXEC);
+        if (fd < 0) fail("memfd_create");
+        if (::ftruncate(fd, static_cast<off_t>(capacity)) < 0) fail("ftruncate", fd);
+
+        // reserve the address range for both views, then map the file over each half
+        auto reserved = ::mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED) fail("mmap", fd);
+
+        auto base = static_cast<char *>(reserved);
+        if (::mmap(base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+         || ::mmap(base + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+            fail("mmap", fd, reserved, 2 * capacity);
+        }
+
+        // the mappings keep the memory alive
+        ::close(fd);
+
+        m_data = base;
+        m_capacity = capacity;
+    }
+
+    mirrored_ring_buffer::~mirrored_ring_buffer()
+    {
+        if (m_data != nullptr) ::munmap(m_data, 2 * m_capacity);
+    }
+
+}
@@ -3,11 +3,13 @@
 // #include "dd99/wayland/engine.hpp"
 #include <dd99/wayland/types.hpp>
 // #include "dd99/wayland/interface.hpp"
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
-#include <stack>
 #include <stdexcept>
 #include <sys/types.h>
 #include <type_traits>
@@ -21,33 +23,32 @@
 namespace dd99::wayland::detail
 {
 
-    template <class Tp, class Sequence = std::vector<Tp>>
-    struct clearable_stack : std::stack<Tp, Sequence>
-    {
-        using base = std::stack<Tp, Sequence>;
-
-        void clear() { base::c.clear(); }
-    };
-
-
-    // A wrapper around std::vector<T*>.
-    // Acts as a map<Id_T, T*> where keys are automatically allocated sequentially.
-    // Erasing elements uses a freelist and does not affect other elements (constant time, no invalidation except iterator to erased element).
+    // A wrapper around std::vector<Value>.
+    // Acts as a map<Id_T, Value> where keys are automatically allocated: `insert` takes the lowest free key (as libwayland does),
+    // so live values stay packed at the front of the vector.
+    // Erased keys are marked in a bitmap (one bit per element, found with a count-trailing-zeros over 64-bit words).
+    // Erasing the last element trims the free elements at the back, and the vector releases its memory once it is mostly unused
+    // (then pointers to the elements are invalidated: do not keep them across `erase`).
+    // Keys allocated elsewhere (i.e. by the wayland server) are stored with `insert_at` and removed with `reset`, which bypass the bitmap.
     // Template argument `Base_ID` is the Id of the first element. All element Ids are offset by this value.
-    template <class T, class ID_T, ID_T Base_ID>
+    // `Value` is a pointer or a slot type: a default constructed (empty) value must convert to false.
+    template <class Value, class ID_T, ID_T Base_ID>
     struct object_map
     {
         using key_type = ID_T;
-        using mapped_type = T*;
-        using value_type = T*;
-        using size_type = std::make_unsigned<key_type>;
-        using difference_type = std::make_signed<key_type>;
+        using mapped_type = Value;
+        using value_type = Value;
+        using size_type = std::make_unsigned_t<key_type>;
+        using difference_type = std::make_signed_t<key_type>;
         using reference = value_type &;
         using const_reference = const value_type &;
         using underlying_t = std::vector<value_type>;
 
         static constexpr key_type base_key = Base_ID;
 
+        // the vector is shrunk when less than a quarter of its capacity (at least this much) is used
+        static constexpr std::size_t shrink_min_capacity = 256;
+
         struct iterator
         {
             object_map * container;
@@ -68,6 +69,7 @@ namespace dd99::wayland::detail
             constexpr iterator operator++(int) { auto tmp = *this; advance_to_next(); return tmp; }
             constexpr reference operator*() const { return *current; }
             constexpr key_type get_key() const { return base_key + static_cast<key_type>(current - container->m_objects.begin()); }
+            constexpr bool operator==(const iterator &) const = default;
 
 
         private:
@@ -98,12 +100,20 @@ namespace dd99::wayland::detail
             return *iterator{this, key};
         }
 
+        // nullptr when the key is out of range (the value may be empty)
+        constexpr value_type * find(key_type key)
+        {
+            // keys below the base wrap around and fail the same comparison
+            const auto index = static_cast<std::size_t>(static_cast<key_type>(key - base_key));
+            return (index < m_objects.size()) ? &m_objects[index] : nullptr;
+        }
+
         constexpr reference at(key_type key)
         {
             auto & r = operator[](key);
 
             // check if object is present in map
-            // !r translates to a call to std::unique_ptr<T>::operator bool
+            // !r translates to a contextual conversion of the value to bool
             if (!key_bounds_check(key) || !r)
                 throw std::out_of_range{"dd99::wayland::object_map: access out of bounds"};
 
@@ -111,27 +121,26 @@ namespace dd99::wayland::detail
         }
 
         constexpr bool empty() { return m_objects.empty(); }
-        constexpr size_type size() { return m_objects.size(); }
+        constexpr size_type size() { return static_cast<size_type>(m_objects.size()); }
         constexpr size_type max_size() { return std::min(m_objects.max_size(), std::numeric_limits<key_type>::max()); }
 
-        constexpr void clear() { m_objects.clear(); m_freelist.clear(); }
+        constexpr void clear() { m_objects.clear(); m_free_bits.clear(); m_first_free_word = 0; }
         constexpr iterator insert(value_type && x)
         {
-            key_type new_key;
+            const auto index = find_first_free();
 
-            if (!m_freelist.empty())
+            if (index < m_objects.size())
             {
-                new_key = m_freelist.top();
-                m_freelist.pop();
-                assert(!(*this)[new_key]); // check the id is not in use
-                (*this)[new_key] = std::move(x);
+                m_free_bits[index / word_bits] &= ~bit(index);
+                assert(!m_objects[index]); // check the id is not in use
+                m_objects[index] = std::move(x);
             }
             else
             {
-                new_key = static_cast<key_type>(base_key + m_objects.size());
                 m_objects.push_back(std::move(x));
+                if (m_free_bits.size() * word_bits < m_objects.size()) m_free_bits.push_back(0);
             }
-            return iterator{this, new_key};
+            return iterator{this, static_cast<key_type>(base_key + index)};
         }
         // template <class U = T, class ... Args>
         // constexpr iterator emplace(Args && ... args)
@@ -154,17 +163,45 @@ namespace dd99::wayland::detail
         // }
         constexpr void erase(key_type key)
         {
-            operator[](key) = nullptr;
-            m_freelist.push(key);
+            operator[](key) = value_type{};
+
+            const auto index = static_cast<std::size_t>(key - base_key);
+            m_free_bits[index / word_bits] |= bit(index);
+            m_first_free_word = std::min(m_first_free_word, index / word_bits);
+
+            if (index + 1 == m_objects.size()) trim();
+        }
+
+        // store a value with a key chosen by the caller. The container grows to fit the key
+        // not to be mixed with `insert`/`erase` (the bitmap does not know about these keys)
+        constexpr iterator insert_at(key_type key, value_type && x)
+        {
+            assert(key >= base_key);
+            const auto index = static_cast<std::size_t>(key - base_key);
+            if (index >= m_objects.size()) m_objects.resize(index + 1);
+            m_objects[index] = std::move(x);
+            return iterator{this, key};
+        }
+
+        // empty the value of a key stored with `insert_at`
+        constexpr void reset(key_type key)
+        {
+            operator[](key) = value_type{};
         }
         // swap
 
-        // find
         // contains
         
-        // begin
+        // iterates over non-empty values
+        constexpr iterator begin()
+        {
+            iterator it{this, m_objects.begin()};
+            if (it.current != m_objects.end() && !*it.current) ++it;
+            return it;
+        }
+        constexpr iterator end() { return iterator{this, m_objects.end()}; }
+
         // cbegin
-        // end
         // cend
         // rbegin
         // crbegin
@@ -172,13 +209,47 @@ namespace dd99::wayland::detail
         // crend
 
 
+    private: // free keys
+        using word_t = std::uint64_t;
+        static constexpr std::size_t word_bits = std::numeric_limits<word_t>::digits;
+
+        static constexpr word_t bit(std::size_t index) { return word_t{1} << (index % word_bits); }
+
+        constexpr bool is_free(std::size_t index) const { return (m_free_bits[index / word_bits] & bit(index)) != 0; }
+
+        // index of the lowest free element (the size of the vector when there is none)
+        constexpr std::size_t find_first_free()
+        {
+            for (; m_first_free_word < m_free_bits.size(); ++m_first_free_word)
+            {
+                if (auto word = m_free_bits[m_first_free_word])
+                    return m_first_free_word * word_bits + static_cast<std::size_t>(std::countr_zero(word));
+            }
+            return m_objects.size();
+        }
+
+        // drops the free elements at the back
+        constexpr void trim()
+        {
+            auto size = m_objects.size();
+            for (; size > 0 && is_free(size - 1); --size) m_free_bits[(size - 1) / word_bits] &= ~bit(size - 1);
+
+            m_objects.erase(m_objects.begin() + static_cast<std::ptrdiff_t>(size), m_objects.end());
+            m_free_bits.resize((size + word_bits - 1) / word_bits);
+            m_first_free_word = std::min(m_first_free_word, m_free_bits.size());
+
+            if (m_objects.capacity() >= shrink_min_capacity && size < m_objects.capacity() / 4)
+            {
+                m_objects.shrink_to_fit();
+                m_free_bits.shrink_to_fit();
+            }
+        }
+
+
     private: // checks
         constexpr bool key_bounds_check(key_type key)
         {
-            auto key_begin = base_key;
-            auto key_end = base_key + m_objects.size();
-
-            return (key >= key_begin) && (key < key_end);
+            return find(key) != nullptr;
         }
         constexpr bool is_object_present(key_type key)
         {
@@ -188,8 +259,8 @@ namespace dd99::wayland::detail
 
 
     private:
-        clearable_stack<key_type, std::vector<key_type>> m_freelist{};
-        // std::stack<key_type, std::vector<key_type>> m_freelist;
+        std::vector<word_t> m_free_bits{};      // one bit per element of `m_objects`, set for erased keys
+        std::size_t m_first_free_word = 0;      // the words before this one have no free key
         underlying_t m_objects{};
     };
 
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <span>
+#include <sys/uio.h>
+#include <utility>
+#include <vector>
+
+// private header
+// to be used only in library implementation code
+
+
+
+namespace dd99::wayland::detail
+{
+
+    // Byte buffer for outgoing messages, plus a queue of the file descriptors they carry.
+    // Data is appended at the back and consumed from the front.
+    // Consumed space is reclaimed lazily: the buffer is rewound when it becomes empty,
+    // and compacted only when an append would otherwise need to grow it.
+    // 
+    // Each queued file descriptor remembers the end of the message that carries it,
+    // so that the data can be split in chunks that carry a limited number of file descriptors.
+    struct output_buffer
+    {
+        void append(std::span<const char> data, std::span<int> fds)
+        {
+            make_room(data.size());
+            m_data.insert(m_data.end(), data.begin(), data.end());
+            end_message(fds);
+        }
+
+        // appends a single message given as a list of segments
+        void append(std::span<const ::iovec> data, std::span<int> fds)
+        {
+            std::size_t size = 0;
+            for (const auto & x : data) size += x.iov_len;
+
+            make_room(size);
+            for (const auto & x : data)
+            {
+                auto p = static_cast<const char *>(x.iov_base);
+                m_data.insert(m_data.end(), p, p + x.iov_len);
+            }
+            end_message(fds);
+        }
+
+        // drops `count` bytes from the front (sent data)
+        void consume(std::size_t count)
+        {
+            m_begin += count;
+            m_consumed_total += count;
+            if (m_begin == m_data.size())
+            {
+                m_data.clear();
+                m_begin = 0;
+            }
+        }
+
+        // drops `count` file descriptors from the front of the queue (sent along with data)
+        void consume_fds(std::size_t count)
+        {
+            m_fd_begin += count;
+            if (m_fd_begin == m_fds.size())
+            {
+                m_fds.clear();
+                m_fd_message_ends.clear();
+                m_fd_begin = 0;
+            }
+        }
+
+        // Size of the data that must be sent together with the first `fd_count` queued file descriptors:
+        // everything up to the end of the message that carries the last of them.
+        // Sending more data than this is allowed only if no more file descriptors are queued.
+        std::size_t data_size_for_fds(std::size_t fd_count) const
+        {
+            assert(fd_count > 0 && fd_count <= fds_size());
+            auto message_end = m_fd_message_ends[m_fd_begin + fd_count - 1];
+            return (message_end > m_consumed_total) ? message_end - m_consumed_total : 0;
+        }
+
+        // number of messages appended since the last call
+        std::size_t take_message_count() { return std::exchange(m_message_count, 0); }
+
+        std::span<const char> data() const { return std::span{m_data}.subspan(m_begin); }
+        std::span<int> fds() { return std::span{m_fds}.subspan(m_fd_begin); }
+
+        std::size_t size() const { return m_data.size() - m_begin; }
+        std::size_t fds_size() const { return m_fds.size() - m_fd_begin; }
+        bool empty() const { return size() == 0 && fds_size() == 0; }
+
+
+    private:
+        void make_room(std::size_t size)
+        {
+            if (m_begin != 0 && m_data.size() + size > m_data.capacity())
+            {
+                // reclaim consumed space before growing
+                m_data.erase(m_data.begin(), m_data.begin() + static_cast<std::ptrdiff_t>(m_begin));
+                m_begin = 0;
+            }
+        }
+
+        void end_message(std::span<int> fds)
+        {
+            auto message_end = m_consumed_total + size();
+            m_fds.insert(m_fds.end(), fds.begin(), fds.end());
+            m_fd_message_ends.insert(m_fd_message_ends.end(), fds.size(), message_end);
+            ++m_message_count;
+        }
+
+
+    private:
+        std::vector<char> m_data{};
+        std::size_t m_begin = 0; // first byte not yet sent
+        std::size_t m_consumed_total = 0; // stream offset of `m_begin`
+
+        std::vector<int> m_fds{};
+        std::vector<std::size_t> m_fd_message_ends{}; // stream offsets, parallel to `m_fds`
+        std::size_t m_fd_begin = 0; // first file descriptor not yet sent
+
+        std::size_t m_message_count = 0;
+    };
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+// private header
+// to be used only in library implementation code
+
+
+
+namespace dd99::wayland::detail
+{
+
+    // Memory for the objects made by `engine::create`.
+    // There is one pool per block size (object sizes rounded up to `block_alignment`), and pools grow by slabs of `blocks_per_slab` blocks.
+    // Freed blocks are reused last-freed first, while they are still in cache.
+    // Slabs are only released when the pools are destroyed (objects still allocated are not destroyed here).
+    struct slab_pools
+    {
+        static constexpr std::size_t block_alignment = alignof(std::max_align_t);
+        static constexpr std::size_t blocks_per_slab = 64;
+
+        slab_pools() = default;
+        slab_pools(const slab_pools &) = delete;
+        slab_pools & operator=(const slab_pools &) = delete;
+
+        void * allocate(std::size_t size)
+        {
+            auto & pool = find_pool((std::max<std::size_t>(size, sizeof(free_block)) + block_alignment - 1) & ~(block_alignment - 1));
+            if (pool.free_list == nullptr) [[unlikely]] add_slab(pool);
+
+            auto block = pool.free_list;
+            pool.free_list = block->next;
+            block->slab->allocated |= block_bit(*block->slab, block);
+            return block;
+        }
+
+        // the block must come from `allocate`
+        void deallocate(void * ptr)
+        {
+            auto slab = find_slab(ptr);
+            assert(slab != nullptr && (slab->allocated & block_bit(*slab, ptr)));
+            slab->allocated &= ~block_bit(*slab, ptr);
+
+            auto & pool = m_pools[slab->pool];
+            pool.free_list = new (ptr) free_block{pool.free_list, slab};
+        }
+
+        // True only for the start of a block that is currently allocated.
+        // Addresses inside a block (i.e. a member of an object made by `engine::create`) are not owned.
+        bool owns(const void * ptr) const
+        {
+            auto slab = find_slab(ptr);
+            if (slab == nullptr) return false;
+
+            const auto offset = static_cast<std::size_t>(static_cast<const std::byte *>(ptr) - slab->memory.get());
+            return (offset % m_pools[slab->pool].block_size == 0) && (slab->allocated & block_bit(*slab, ptr));
+        }
+
+        // blocks currently allocated (walks every slab: used on destruction)
+        std::vector<void *> allocated_blocks() const
+        {
+            std::vector<void *> blocks;
+            for (const auto & slab : m_slabs)
+            for (std::size_t i = 0; i < blocks_per_slab; ++i)
+                if ((slab.allocated >> i) & 1) blocks.push_back(slab.memory.get() + i * m_pools[slab.pool].block_size);
+            return blocks;
+        }
+
+
+    private:
+        struct slab_t;
+
+        // link of the free list, stored in the free block itself
+        struct free_block
+        {
+            free_block * next;
+            slab_t * slab;          // the slab of this block
+        };
+
+        struct pool_t
+        {
+            std::size_t block_size;
+            free_block * free_list = nullptr;
+        };
+
+        struct slab_t
+        {
+            std::unique_ptr<std::byte[]> memory;
+            std::size_t pool;       // index in `m_pools`
+            std::uint64_t allocated = 0;    // one bit per block
+        };
+        static_assert(blocks_per_slab == 64, "one bit per block in `slab_t::allocated`");
+
+        // bit of a block in `slab_t::allocated`
+        std::uint64_t block_bit(const slab_t & slab, const void * block) const
+        {
+            const auto offset = static_cast<std::size_t>(static_cast<const std::byte *>(block) - slab.memory.get());
+            return std::uint64_t{1} << (offset / m_pools[slab.pool].block_size);
+        }
+
+        pool_t & find_pool(std::size_t block_size)
+        {
+            auto it = std::ranges::find(m_pools, block_size, &pool_t::block_size);
+            if (it != m_pools.end()) [[likely]] return *it;
+            return m_pools.emplace_back(block_size);
+        }
+
+        void add_slab(pool_t & pool)
+        {
+            const auto pool_index = static_cast<std::size_t>(&pool - m_pools.data());
+            auto & slab = m_slabs.emplace_back(std::unique_ptr<std::byte[]>{new std::byte[blocks_per_slab * pool.block_size]}, pool_index);
+
+            // blocks are handed out in address order
+            for (std::size_t i = blocks_per_slab; i-- > 0;)
+                pool.free_list = new (slab.memory.get() + i * pool.block_size) free_block{pool.free_list, &slab};
+
+            // slabs are indexed by address (for `find_slab`)
+            auto it = std::ranges::upper_bound(m_sorted_slabs, slab.memory.get(), std::less{}, [](const auto * x){ return x->memory.get(); });
+            m_sorted_slabs.insert(it, &slab);
+        }
+
+        slab_t * find_slab(const void * ptr) const
+        {
+            auto p = static_cast<const std::byte *>(ptr);
+            auto it = std::ranges::upper_bound(m_sorted_slabs, p, std::less{}, [](const auto * x){ return static_cast<const std::byte *>(x->memory.get()); });
+            if (it == m_sorted_slabs.begin()) return nullptr;
+            --it;
+            return (p < (*it)->memory.get() + blocks_per_slab * m_pools[(*it)->pool].block_size) ? *it : nullptr;
+        }
+
+        std::vector<pool_t> m_pools{};
+        std::deque<slab_t> m_slabs{};                   // stable addresses (free blocks point to their slab)
+        std::vector<slab_t *> m_sorted_slabs{};        // sorted by address
+    };
+
+}
@@ -0,0 +1,229 @@
+#include <dd99/wayland/unix_socket_engine.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+
+
+namespace dd99::wayland
+{
+
+    namespace
+    {
+
+        [[noreturn]] void throw_errno(const char * what)
+        {
+            throw std::system_error{errno, std::system_category(), what};
+        }
+
+        // the operation would block (EAGAIN and EWOULDBLOCK may be the same value)
+        bool operation_would_block(int error)
+        {
+#if EAGAIN != EWOULDBLOCK
+            if (error == EWOULDBLOCK) return true;
+#endif
+            return error == EAGAIN;
+        }
+
+        std::filesystem::path get_display_path()
+        {
+            const char * display = std::getenv("WAYLAND_DISPLAY");
+            if (display == nullptr) display = "wayland-0";
+
+            std::filesystem::path display_path{display};
+            if (display_path.is_absolute()) return display_path;
+
+            const char * runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+            if (runtime_dir == nullptr || *runtime_dir == '\0') throw std::runtime_error{"XDG_RUNTIME_DIR is not set"};
+
+            return std::filesystem::path{runtime_dir} / display_path;
+        }
+
+        int connect_to_display()
+        {
+            // socket inherited from the parent process
+            if (const char * socket_env = std::getenv("WAYLAND_SOCKET"))
+            {
+                char * end;
+                errno = 0;
+                auto fd = std::strtol(socket_env, &end, 10);
+                if (errno != 0 || *end != '\0' || end == socket_env || fd < 0) throw std::runtime_error{"invalid WAYLAND_SOCKET"};
+
+                // do not leak the socket to child processes
+                ::unsetenv("WAYLAND_SOCKET");
+                if (::fcntl(static_cast<int>(fd), F_SETFD, FD_CLOEXEC) < 0) throw_errno("fcntl");
+                return static_cast<int>(fd);
+            }
+
+            const std::string path = get_display_path();
+
+            ::sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error{"wayland socket path is too long"};
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+            int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0) throw_errno("socket");
+
+            if (::connect(fd, reinterpret_cast<const ::sockaddr *>(&address), sizeof(address)) < 0)
+            {
+                auto error = errno;
+                ::close(fd);
+                throw std::system_error{error, std::system_category(), "connect"};
+            }
+
+            return fd;
+        }
+
+    }
+
+
+
+    unix_socket_engine::unix_socket_engine()
+        : unix_socket_engine{connect_to_display()}
+    { }
+
+    unix_socket_engine::unix_socket_engine(int fd)
+        : m_fd{fd}
+    {
+        auto flags = ::fcntl(m_fd, F_GETFL);
+        if (flags < 0 || ::fcntl(m_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            auto error = errno;
+            ::close(m_fd);
+            throw std::system_error{error, std::system_category(), "fcntl"};
+        }
+
+        enable_output_buffering();
+    }
+
+    unix_socket_engine::~unix_socket_engine()
+    {
+        ::close(m_fd);
+    }
+
+
+    std::size_t unix_socket_engine::read_events()
+    {
+        std::size_t total = 0;
+
+        for (;;)
+        {
+            // a partial message waits in place. Stop when the buffer is full (dispatch makes room)
+            auto window = m_input_buffer.write_window();
+            if (window.empty()) break;
+
+            ::iovec iov {
+                .iov_base = window.data(),
+                .iov_len = window.size(),
+            };
+
+            ::msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            m_scm_rights_in.prepare_receive(msg);
+
+            auto n = ::recvmsg(m_fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                if (operation_would_block(errno)) break;
+                throw_errno("recvmsg");
+            }
+
+            // end of stream. Report it once what was read before has been returned
+            if (n == 0)
+            {
+                if (total != 0) break;
+                throw std::runtime_error{"wayland connection closed by server"};
+            }
+
+            // received file descriptors are queued by the engine and dispatched with their events
+            decltype(m_scm_rights_in)::for_each_received_fd(msg, [&](int fd){ push_input_fds({&fd, 1}); });
+            if (msg.msg_flags & MSG_CTRUNC) [[unlikely]] throw std::runtime_error{"received file descriptors were truncated"};
+
+            m_input_buffer.commit(static_cast<std::size_t>(n));
+            total += static_cast<std::size_t>(n);
+
+            // socket drained
+            if (static_cast<std::size_t>(n) < iov.iov_len) break;
+        }
+
+        return total;
+    }
+
+    std::size_t unix_socket_engine::dispatch_pending()
+    {
+        auto consumed = process_input(m_input_buffer.read_window());
+        m_input_buffer.consume(consumed);
+        return consumed;
+    }
+
+    std::size_t unix_socket_engine::dispatch()
+    {
+        flush();
+        read_events();
+        return dispatch_pending();
+    }
+
+
+
+    void unix_socket_engine::on_output(std::span<const char> data, std::span<int> fds)
+    {
+        while (!data.empty())
+        {
+            const ::iovec iov {
+                .iov_base = const_cast<char *>(data.data()),
+                .iov_len = data.size(),
+            };
+
+            auto n = on_flush({&iov, 1}, fds);
+            if (n == 0)
+            {
+                wait_for(POLLOUT);
+                continue;
+            }
+
+            fds = {};
+            data = data.subspan(n);
+        }
+    }
+
+    std::size_t unix_socket_engine::on_flush(std::span<const ::iovec> data, std::span<int> fds)
+    {
+        ::msghdr msg{};
+        msg.msg_iov = const_cast<::iovec *>(data.data());
+        msg.msg_iovlen = data.size();
+        m_scm_rights_out.attach(msg, fds);
+
+        for (;;)
+        {
+            auto n = ::sendmsg(m_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n >= 0) return static_cast<std::size_t>(n);
+            if (errno == EINTR) continue;
+            if (operation_would_block(errno)) return 0;
+            throw_errno("sendmsg");
+        }
+    }
+
+
+    void unix_socket_engine::wait_for(short events)
+    {
+        ::pollfd pfd{.fd = m_fd, .events = events, .revents = 0};
+        while (::poll(&pfd, 1, -1) < 0)
+        {
+            if (errno != EINTR) throw_errno("poll");
+        }
+    }
+
+}
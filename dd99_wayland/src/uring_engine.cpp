@@ -0,0 +1,425 @@
+#include <dd99/wayland/uring_engine.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+
+
+namespace dd99::wayland
+{
+
+    uring_engine::uring_engine(int fd)
+        : uring_engine{fd, uring_engine_config{}}
+    { }
+
+    uring_engine::uring_engine(int fd, const uring_engine_config & config)
+        : m_fd{fd}
+        , m_config{config}
+        , m_input_memory{std::make_unique_for_overwrite<char[]>(config.input_buffer_count * config.input_buffer_size)}
+        , m_output_memory{std::make_unique_for_overwrite<char[]>(config.output_slot_count * config.output_slot_size)}
+    {
+        assert(std::has_single_bit(config.input_buffer_count));
+        assert(config.output_slot_count > 0);
+
+        if (auto ret = ::io_uring_queue_init(config.queue_depth, &m_ring, 0); ret < 0)
+            throw std::system_error{-ret, std::system_category(), "io_uring_queue_init"};
+
+        int ret = 0;
+        m_input_ring = ::io_uring_setup_buf_ring(&m_ring, config.input_buffer_count, input_buffer_group, 0, &ret);
+        if (m_input_ring == nullptr)
+        {
+            ::io_uring_queue_exit(&m_ring);
+            throw std::system_error{-ret, std::system_category(), "io_uring_setup_buf_ring"};
+        }
+
+        for (unsigned i = 0; i < config.input_buffer_count; ++i)
+        {
+            ::io_uring_buf_ring_add(m_input_ring, m_input_memory.get() + i * config.input_buffer_size, static_cast<unsigned>(config.input_buffer_size)
+                , static_cast<unsigned short>(i), ::io_uring_buf_ring_mask(config.input_buffer_count), static_cast<int>(i));
+        }
+        ::io_uring_buf_ring_advance(m_input_ring, static_cast<int>(config.input_buffer_count));
+
+        // template for the multishot receive: no address, room for file descriptors
+        m_receive_msg.msg_controllen = CMSG_SPACE(sizeof(int) * max_fds_per_message);
+
+        m_slots.resize(config.output_slot_count);
+        for (std::size_t i = 0; i < config.output_slot_count; ++i)
+        {
+            m_slots[i].data = m_output_memory.get() + i * config.output_slot_size;
+            m_free_slots.push_back(config.output_slot_count - 1 - i);
+        }
+
+        arm_receive();
+        ::io_uring_submit(&m_ring);
+
+        enable_output_buffering();
+    }
+
+    uring_engine::~uring_engine()
+    {
+        // Requests still in flight reference buffers owned by this object.
+        // Cancel them and wait for their completions before releasing anything.
+        if (m_receive_armed || m_sends_in_flight != 0)
+        {
+            auto sqe = ::io_uring_get_sqe(&m_ring);
+            if (sqe == nullptr)
+            {
+                ::io_uring_submit(&m_ring);
+                sqe = ::io_uring_get_sqe(&m_ring);
+            }
+            ::io_uring_prep_cancel_fd(sqe, m_fd, IORING_ASYNC_CANCEL_ALL);
+            ::io_uring_sqe_set_data64(sqe, cancel_user_data);
+            ::io_uring_submit(&m_ring);
+
+            while (m_receive_armed || m_sends_in_flight != 0)
+            {
+                ::io_uring_cqe * cqe;
+                if (::io_uring_wait_cqe(&m_ring, &cqe) < 0) break;
+
+                auto user_data = ::io_uring_cqe_get_data64(cqe);
+                if (user_data == receive_user_data)
+                {
+                    if (!(cqe->flags & IORING_CQE_F_MORE)) m_receive_armed = false;
+                }
+                else if (user_data != cancel_user_data) --m_sends_in_flight;
+
+                ::io_uring_cqe_seen(&m_ring, cqe);
+            }
+        }
+
+        for (auto & slot : m_slots) close_slot_fds(slot);
+
+        ::io_uring_free_buf_ring(&m_ring, m_input_ring, m_config.input_buffer_count, input_buffer_group);
+        ::io_uring_queue_exit(&m_ring);
+        ::close(m_fd);
+    }
+
+
+    std::size_t uring_engine::run_once(bool wait)
+    {
+        flush();
+
+        // nothing to wait for once the connection is closed
+        wait = wait && m_received.empty() && (m_receive_armed || m_sends_in_flight != 0);
+
+        if (wait) ::io_uring_submit_and_wait(&m_ring, 1);
+        else ::io_uring_submit(&m_ring);
+
+        reap_completions();
+        auto dispatched = dispatch_received();
+
+        // the multishot receive stops when it runs out of buffers (buffers were given back by the dispatch)
+        if (!m_receive_armed && m_connected) arm_receive();
+
+        // output generated by event handlers is submitted by the next call
+        flush();
+
+        return dispatched;
+    }
+
+
+
+    void uring_engine::on_output(std::span<const char> data, std::span<int> fds)
+    {
+        while (!data.empty())
+        {
+            const ::iovec iov {
+                .iov_base = const_cast<char *>(data.data()),
+                .iov_len = data.size(),
+            };
+
+            auto n = on_flush({&iov, 1}, fds);
+            if (n == 0)
+            {
+                // no slot is freed once the connection is closed
+                if (!m_connected) throw std::system_error{EPIPE, std::system_category(), "send"};
+
+                // wait for a send slot. Received data is kept for the next `run_once`
+                if (auto ret = ::io_uring_submit_and_wait(&m_ring, 1); ret < 0 && ret != -EINTR)
+                    throw std::system_error{-ret, std::system_category(), "io_uring_submit_and_wait"};
+                reap_completions();
+                continue;
+            }
+
+            fds = {};
+            data = data.subspan(n);
+        }
+    }
+
+    std::size_t uring_engine::on_flush(std::span<const ::iovec> data, std::span<int> fds)
+    {
+        if (m_free_slots.empty()) return 0;
+
+        auto index = m_free_slots.back();
+        auto & slot = m_slots[index];
+        slot.size = 0;
+        slot.sent = 0;
+
+        for (const auto & x : data)
+        {
+            auto count = std::min(x.iov_len, m_config.output_slot_size - slot.size);
+            std::memcpy(slot.data + slot.size, x.iov_base, count);
+            slot.size += count;
+            if (slot.size == m_config.output_slot_size) break;
+        }
+
+        if (slot.size == 0) return 0;
+
+        // the caller may close its file descriptors once this function returns
+        for (auto fd : fds)
+        {
+            auto copy = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if (copy < 0)
+            {
+                auto error = errno;
+                close_slot_fds(slot);
+                throw std::system_error{error, std::system_category(), "fcntl"};
+            }
+            slot.fds.push_back(copy);
+        }
+
+        m_free_slots.pop_back();
+        m_queued_slots.push_back(index);
+        submit_output();
+
+        return slot.size;
+    }
+
+
+    void uring_engine::arm_receive()
+    {
+        auto sqe = ::io_uring_get_sqe(&m_ring);
+        if (sqe == nullptr) [[unlikely]] return; // retried by the next `run_once`
+
+        ::io_uring_prep_recvmsg_multishot(sqe, m_fd, &m_receive_msg, MSG_CMSG_CLOEXEC);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = input_buffer_group;
+        ::io_uring_sqe_set_data64(sqe, receive_user_data);
+
+        m_receive_armed = true;
+    }
+
+    void uring_engine::submit_output()
+    {
+        // one chain at a time. The rest is submitted when the chain completes
+        if (m_sends_in_flight != 0 || !m_connected) return;
+
+        // a chain must not be split: its last request is the one without the link flag
+        auto count = std::min<std::size_t>(m_queued_slots.size(), ::io_uring_sq_space_left(&m_ring));
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto index = m_queued_slots[i];
+            auto & slot = m_slots[index];
+            auto sqe = ::io_uring_get_sqe(&m_ring);
+
+            slot.iov = {
+                .iov_base = slot.data + slot.sent,
+                .iov_len = slot.size - slot.sent,
+            };
+
+            if (!slot.fds.empty())
+            {
+                slot.msg = {};
+                slot.msg.msg_iov = &slot.iov;
+                slot.msg.msg_iovlen = 1;
+                slot.scm_rights.attach(slot.msg, slot.fds);
+                ::io_uring_prep_sendmsg(sqe, m_fd, &slot.msg, MSG_NOSIGNAL);
+            }
+            else ::io_uring_prep_send(sqe, m_fd, slot.iov.iov_base, slot.iov.iov_len, MSG_NOSIGNAL);
+
+            ::io_uring_sqe_set_data64(sqe, index);
+            if (i + 1 != count) sqe->flags |= IOSQE_IO_LINK;
+
+            ++m_sends_in_flight;
+        }
+    }
+
+    void uring_engine::reap_completions()
+    {
+        ::io_uring_cqe * cqe_ptr;
+        while (::io_uring_peek_cqe(&m_ring, &cqe_ptr) == 0)
+        {
+            const auto cqe = *cqe_ptr;
+            ::io_uring_cqe_seen(&m_ring, cqe_ptr);
+
+            auto user_data = ::io_uring_cqe_get_data64(&cqe);
+            if (user_data == receive_user_data) handle_receive(cqe);
+            else if (user_data != cancel_user_data) handle_send(cqe);
+        }
+
+        // release fully sent slots (in stream order)
+        while (!m_queued_slots.empty())
+        {
+            auto & slot = m_slots[m_queued_slots.front()];
+            if (slot.sent != slot.size) break;
+            m_free_slots.push_back(m_queued_slots.front());
+            m_queued_slots.pop_front();
+        }
+
+        submit_output();
+    }
+
+    void uring_engine::handle_receive(const ::io_uring_cqe & cqe)
+    {
+        if (!(cqe.flags & IORING_CQE_F_MORE)) m_receive_armed = false;
+
+        if (cqe.res < 0)
+        {
+            // out of buffers or cancelled: re-armed by `run_once`
+            if (cqe.res == -ENOBUFS || cqe.res == -ECANCELED || cqe.res == -EINTR) return;
+            throw std::system_error{-cqe.res, std::system_category(), "recvmsg"};
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_BUFFER))
+        {
+            if (cqe.res == 0) m_connected = false;
+            return;
+        }
+
+        auto buffer_id = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        auto buffer = m_input_memory.get() + buffer_id * m_config.input_buffer_size;
+
+        auto out = ::io_uring_recvmsg_validate(buffer, cqe.res, &m_receive_msg);
+        if (out == nullptr) [[unlikely]]
+        {
+            return_input_buffer(buffer_id);
+            throw std::runtime_error{"invalid recvmsg completion"};
+        }
+
+        for (auto cmsg = ::io_uring_recvmsg_cmsg_firsthdr(out, &m_receive_msg); cmsg != nullptr; cmsg = ::io_uring_recvmsg_cmsg_nexthdr(out, &m_receive_msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+            const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                push_input_fds({&fd, 1});
+            }
+        }
+
+        if (out->flags & MSG_CTRUNC) [[unlikely]]
+        {
+            return_input_buffer(buffer_id);
+            throw std::runtime_error{"received file descriptors were truncated"};
+        }
+
+        auto payload_size = ::io_uring_recvmsg_payload_length(out, cqe.res, &m_receive_msg);
+        if (payload_size == 0)
+        {
+            // end of stream
+            m_connected = false;
+            return_input_buffer(buffer_id);
+            return;
+        }
+
+        m_received.push_back({
+            .buffer_id = buffer_id,
+            .data = static_cast<const char *>(::io_uring_recvmsg_payload(out, &m_receive_msg)),
+            .size = payload_size,
+        });
+    }
+
+    void uring_engine::handle_send(const ::io_uring_cqe & cqe)
+    {
+        --m_sends_in_flight;
+        auto & slot = m_slots[::io_uring_cqe_get_data64(&cqe)];
+
+        if (cqe.res > 0)
+        {
+            // file descriptors go with the first byte
+            slot.sent += static_cast<std::size_t>(cqe.res);
+            close_slot_fds(slot);
+        }
+        else if (cqe.res == 0) m_connected = false;
+        else if (cqe.res != -ECANCELED && cqe.res != -EAGAIN && cqe.res != -EINTR)
+        {
+            throw std::system_error{-cqe.res, std::system_category(), "send"};
+        }
+        // short and cancelled sends (a short send breaks the chain) are submitted again by `submit_output`
+    }
+
+    std::size_t uring_engine::dispatch_received()
+    {
+        constexpr auto header_size = sizeof(object_id_t) + sizeof(std::uint32_t);
+        std::size_t total = 0;
+
+        // size of the message that starts `data`, read from its header (at least `header_size` bytes)
+        auto message_size_of = [&](std::span<const char> data) -> std::size_t
+        {
+            std::uint32_t size_and_opcode;
+            std::memcpy(&size_and_opcode, data.data() + sizeof(object_id_t), sizeof(size_and_opcode));
+            auto message_size = static_cast<std::size_t>(size_and_opcode >> 16);
+            if (message_size < header_size) [[unlikely]] throw std::runtime_error{"invalid message size"};
+            return message_size;
+        };
+        auto partial_message_size = [&]{ return message_size_of(m_partial_message); };
+
+        while (!m_received.empty())
+        {
+            auto received = m_received.front();
+            std::span<const char> data{received.data, received.size};
+
+            // complete the message that straddles the previous buffer
+            while (!m_partial_message.empty() && !data.empty())
+            {
+                auto message_size = (m_partial_message.size() < header_size) ? header_size : partial_message_size();
+
+                auto count = std::min(message_size - m_partial_message.size(), data.size());
+                m_partial_message.insert(m_partial_message.end(), data.begin(), data.begin() + static_cast<std::ptrdiff_t>(count));
+                data = data.subspan(count);
+
+                if (m_partial_message.size() >= header_size && m_partial_message.size() == partial_message_size())
+                {
+                    // file descriptors are received with the data they belong to
+                    auto n = process_input(m_partial_message);
+                    if (n == 0) [[unlikely]] throw std::runtime_error{"file descriptors missing for received message"};
+                    total += n;
+                    m_partial_message.clear();
+                }
+            }
+
+            // dispatch in place
+            if (!data.empty())
+            {
+                auto consumed = process_input(data);
+                total += consumed;
+
+                // only a trailing partial message is kept. File descriptors are received with the data they belong to,
+                // so a complete message that was not dispatched is an error (as above)
+                auto rest = data.subspan(consumed);
+                if (rest.size() >= header_size && rest.size() >= message_size_of(rest)) [[unlikely]]
+                    throw std::runtime_error{"file descriptors missing for received message"};
+                m_partial_message.assign(rest.begin(), rest.end());
+            }
+
+            m_received.pop_front();
+            return_input_buffer(received.buffer_id);
+        }
+
+        return total;
+    }
+
+    void uring_engine::return_input_buffer(unsigned short buffer_id)
+    {
+        ::io_uring_buf_ring_add(m_input_ring, m_input_memory.get() + buffer_id * m_config.input_buffer_size, static_cast<unsigned>(m_config.input_buffer_size)
+            , buffer_id, ::io_uring_buf_ring_mask(m_config.input_buffer_count), 0);
+        ::io_uring_buf_ring_advance(m_input_ring, 1);
+    }
+
+    void uring_engine::close_slot_fds(send_slot & slot)
+    {
+        for (auto fd : slot.fds) ::close(fd);
+        slot.fds.clear();
+    }
+
+}
@@ -130,6 +130,24 @@ struct argument_t : element_t, private argument_type_t
 
     constexpr bool can_ommit_type_in_log() const noexcept { return type() == T_STRING || type() == T_INT || type() == T_UINT || type() == T_FIXED; }
 
+    // wire encoding of the argument, one character per wire element (same letters as libwayland message signatures)
+    // '?' marks nullable strings and objects
+    // unspecified new ids are sent as (interface name, version, id)
+    constexpr std::string_view wire_signature() const noexcept
+    {
+        switch (type().m_type) {
+            case T_INT:     return "i";
+            case T_UINT:    return "u";
+            case T_FIXED:   return "f";
+            case T_OBJECT:  return allow_null ? "?o" : "o";
+            case T_NEWID:   return interface.empty() ? "sun" : "n";
+            case T_STRING:  return allow_null ? "?s" : "s";
+            case T_ARRAY:   return "a";
+            case T_FD:      return "h";
+            default:        return "u"; // enums
+        }
+    }
+
 
     void print_type(code_generation_context_t & ctx) const;
     // {
@@ -247,6 +247,7 @@ struct code_generation_context_t
     bool generate_message_logs;
 
     const std::set<std::string_view> & external_inerface_names;
+    const std::set<std::string_view> & static_dispatch_interface_names; // interfaces that get a `<name>_base<Derived>` class
     const std::vector<protocol_t> & protocols;
 
     const protocol_t * current_protocol_ptr{};
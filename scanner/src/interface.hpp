@@ -5,9 +5,13 @@
 #include "formatting.hpp"
 #include "message.hpp"
 #include "enumeration.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <format>
 #include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 
 
@@ -36,7 +40,7 @@ struct interface_t : element_t
         for (auto request_node : node.children(server_side ? "event" : "request"))
         {
             msg_collection_outgoing.emplace_back(request_node, opcode++);
-            if (std::string_view{node.attribute("type").value()} == "destructor")
+            if (msg_collection_outgoing.back().is_destructor)
                 destructor = {destructor.client_to_server, msg_collection_outgoing.size() - 1};
         }
 
@@ -77,156 +81,173 @@ struct interface_t : element_t
         , name.size() + 14
         , name);
 
-        if (!msg_collection_incoming.empty())
+        for (const auto & msg : msg_collection_incoming)
         {
             ctx.output.format(""
                 "\n"
-                "{0}void {4}::parse_and_dispatch_event(std::span<const char> buf)\n"
-                "{0}{{\n"
-                "{1}object_id_t obj_id;\n"
-                "{1}message_size_t msg_size;\n"
-                "{1}opcode_t code;\n"
-                "{1}\n"
-                "{1}assert(buf.size() >= 8); // header size\n"
-                "{1}\n"
-                "{1}auto data_words = reinterpret_cast<const std::uint32_t *>(buf.data());\n"
-                "{1}obj_id = data_words[0];\n"
-                "{1}msg_size = data_words[1] >> 16;\n"
-                "{1}code = data_words[1] & ((1 << 16) - 1);\n"
-                "{1}\n"
-                "{1}assert(obj_id == m_object_id);\n"
-                "{1}\n"
-                "{1}buf = buf.subspan(8); // skip header\n"
-                "{1}\n"
-                "{1}switch(code){{\n"
-                // "{0}}}\n"
+                "{0}void {1}::dispatch_{2}(interface & object, std::span<const char> buf)\n"
             , whitespace{ctx.indent_size * ctx.indent_level}
-            , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
-            , ""
-            , name.size() + 14
-            , name);
+            , name
+            , msg.name);
+
+            print_event_decoder_body(ctx, msg, name, handler_call_t::virtual_call);
+        }
+
+        print_handled_src(ctx);
+
+        ctx.current_interface_ptr = {};
+    }
+
+    // how event decoders call the handler
+    enum class handler_call_t
+    {
+        virtual_call,   // self.on_<event>(...)
+        static_call,    // Derived::on_<event>(...) (static dispatch classes)
+        handlers,       // self.handlers.on_<event>(...), or the virtual handler when empty (handled classes)
+    };
+
+    // Body of the decoder of an event (after its signature): decodes the message and calls the handler.
+    // Decoders are static functions (see `event_dispatchers`), so the object is accessed through `self`.
+    void print_event_decoder_body(code_generation_context_t & ctx, const message_t & msg, std::string_view self_type, handler_call_t handler_call) const
+    {
+        ctx.output.format(""
+            "{0}{{\n"
+            "{1}{2} & self = static_cast<{2} &>(object);\n"
+            "{1}assert(buf.size() >= 8); // header size\n"
+            "{1}assert(load_msg_arg<object_id_t>(buf.data()) == self.m_object_id);\n"
+            "{1}buf = buf.subspan(8); // skip header\n"
+        , whitespace{ctx.indent_size * ctx.indent_level}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , self_type);
 
-            ctx.indent_level += 2;
-            
-            for (const auto & msg: msg_collection_incoming)
+        ctx.indent_level++;
+        const auto arg_indent = whitespace{ctx.indent_size * ctx.indent_level};
+
+        // decode arguments (straight-line code)
+        // arguments before the first string/array are loaded at constant offsets, the rest use a running offset
+        // file descriptors are not part of the message data (they arrive as ancillary data)
+        if (std::ranges::any_of(msg.args, [](const auto & arg){ return !arg.is_fd(); }))
+        {
+            // 32 bits per argument (strings and arrays: their size)
+            const auto wire_arg_count = static_cast<std::size_t>(std::ranges::count_if(msg.args, [](const auto & arg){ return !arg.is_fd(); }));
+            ctx.output.format("{}assert(buf.size() >= {}); // fixed-size arguments and string/array sizes\n", arg_indent, 4 * wire_arg_count);
+
+            std::size_t offset = 0;             // constant offset, until the first string/array
+            bool is_offset_variable = false;    // `args_offset` holds the offset
+            std::size_t wire_arg_index = 0;
+
+            for (const auto & arg : msg.args)
             {
-                ctx.output.format(""
-                    "{0}case {1}:"
-                    // "{0}{{\n"
-                    // "{1}"
-                    // "{1}auto && ["
-                , whitespace{ctx.indent_size * ctx.indent_level}
-                // , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
-                , msg.opcode);
+                if (arg.is_fd()) continue;
+                const bool is_last_arg = (++wire_arg_index == wire_arg_count);
+
+                const bool is_variable_size = arg.is_string() || arg.is_array();
 
-                if (msg.args.empty()) ctx.output.format(" on_{}(); ", msg.name);
-                else
+                // the first string/array starts the running offset
+                if (is_variable_size && !is_offset_variable)
                 {
-                    ctx.output.format("{{\n"
-                        "{1}auto && ["
-                    , whitespace{ctx.indent_size * ctx.indent_level}
-                    , whitespace{ctx.indent_size * (ctx.indent_level + 1)});
-
-                    // parse arguments
-                    { // argument names
-                        bool is_first_arg = true;
-                        for (const auto & arg : msg.args)
-                        {
-                            if (!is_first_arg) ctx.output.write(", ");
-                            arg.print_name(ctx);
-                            is_first_arg = false;
-                        }
-                    }
-                    ctx.output.write("] = parse_msg_args<");
-                    { // argument types
-                        bool is_first_arg = true;
-                        for (const auto & arg : msg.args)
-                        {
-                            if (!is_first_arg) ctx.output.write(", ");
-                            if (arg.is_interface())
-                            {
-                                ctx.output.write("object_id_t");
-                            }
-                            else arg.print_type(ctx);
-                            is_first_arg = false;
-                        }
-                    }
-                    ctx.output.write(">(buf);\n");
-                    
-                    // lookup object ids
-                    for (const auto & arg : msg.args)
-                    {
-                        if (arg.is_existent_interface())
-                        {
-                            ctx.output.format(""
-                                "{}auto "
-                            , whitespace{ctx.indent_size * (ctx.indent_level + 1)});
-                            arg.print_name(ctx);
-                            ctx.output.write("ptr = m_engine.get_interface");
-                            if (!arg.interface.empty())
-                            {
-                                ctx.output.put('<');
-                                arg.print_type(ctx);
-                                ctx.output.put('>');
-                            }
-                            ctx.output.put('(');
-                            arg.print_name(ctx);
-                            ctx.output.write(");\n");
-                        }
-                    }
-
-                    ctx.output.format(""
-                        "{}on_{}("
-                    , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
-                    , msg.name);
-                    { // argument names
-                        bool is_first_arg = true;
-                        for (const auto & arg : msg.args)
-                        {
-                            if (!is_first_arg) ctx.output.write(", ");
-                            arg.print_name(ctx);
-                            if (arg.is_existent_interface()) ctx.output.write("ptr");
-                            is_first_arg = false;
-                        }
-                    }
-
-                    ctx.output.format(");\n"
-                        "{}}} " // break;
-                    , whitespace{ctx.indent_size * ctx.indent_level}
-                    , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
-                    , msg.name);
-
-                    // close brackets before "break;"
-                    // ctx.output.format(""
-                    //     "{}}} " // break;
-                    // , whitespace{ctx.indent_size * ctx.indent_level});
+                    ctx.output.format("{}std::size_t args_offset = {};\n", arg_indent, offset);
+                    is_offset_variable = true;
                 }
 
-                ctx.output.format(""
-                    // "{0}}}\n"
-                    // "{0}"
-                    "break;\n"
-                , whitespace{ctx.indent_size * ctx.indent_level}
-                , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
-                , msg.opcode);
+                ctx.output.format("{}const auto ", arg_indent);
+                arg.print_name(ctx);
+
+                if (is_variable_size)
+                {
+                    ctx.output.format(" = {}(buf.data(), args_offset);\n", arg.is_string() ? "load_msg_string" : "load_msg_array");
+                    continue;
+                }
+
+                ctx.output.write(" = load_msg_arg<");
+                if (arg.is_interface()) ctx.output.write("object_id_t");
+                else arg.print_type(ctx);
+
+                if (!is_offset_variable) ctx.output.format(">(buf.data() + {});\n", offset);
+                else if (is_last_arg) ctx.output.write(">(buf.data() + args_offset);\n");
+                else ctx.output.write(">(buf.data() + args_offset); args_offset += 4;\n");
+                offset += 4;
             }
+        }
 
-            ctx.indent_level -= 2;
+        // take file descriptors in order
+        for (const auto & arg : msg.args)
+        {
+            if (!arg.is_fd()) continue;
+            ctx.output.format("{}auto ", arg_indent);
+            arg.print_name(ctx);
+            ctx.output.write(" = self.m_engine.take_input_fd();\n");
+        }
 
-            ctx.output.format(""
-                "{1}}}\n"
-                "{0}}}\n"
-            , whitespace(ctx.indent_size * ctx.indent_level)
-            , whitespace(ctx.indent_size * (ctx.indent_level + 1))
-            , name);
+        // objects of the object arguments: looked up, or taken from the event queue dispatching the event
+        for (const auto & arg : msg.args)
+        {
+            if (!arg.is_existent_interface()) continue;
+            ctx.output.format("{}auto ", arg_indent);
+            arg.print_name(ctx);
+            ctx.output.write("ptr = self.m_engine.take_object_argument");
+            if (!arg.interface.empty())
+            {
+                ctx.output.put('<');
+                arg.print_type(ctx);
+                ctx.output.put('>');
+            }
+            ctx.output.put('(');
+            arg.print_name(ctx);
+            ctx.output.write(");\n");
         }
 
-        ctx.current_interface_ptr = {};
+        std::string call_args; // argument names
+        for (const auto & arg : msg.args)
+        {
+            if (!call_args.empty()) call_args += ", ";
+            call_args += std::format("{}", format::argument_name_cpp{ctx, arg});
+            if (arg.is_existent_interface()) call_args += "ptr";
+        }
+
+        switch (handler_call)
+        {
+            case handler_call_t::virtual_call:
+                ctx.output.format("{}self.on_{}({});\n", arg_indent, msg.name, call_args);
+                break;
+            case handler_call_t::static_call:
+                ctx.output.format("{}static_cast<Derived &>(self).Derived::on_{}({});\n", arg_indent, msg.name, call_args);
+                break;
+            case handler_call_t::handlers:
+                ctx.output.format(""
+                    "{0}if (self.handlers.on_{1}) [[likely]] self.handlers.on_{1}({2});\n"
+                    "{0}else self.on_{1}({2});\n"
+                , arg_indent, msg.name, call_args);
+                break;
+        }
+
+        ctx.indent_level--;
+        ctx.output.format("{}}}\n", whitespace{ctx.indent_size * ctx.indent_level});
+    }
+
+    // table of event decoders, indexed by opcode, and the descriptor of the class (the engine stores a pointer to it in the slot of each object)
+    // the other tables are those of the interface (static dispatch and handled classes only have their own decoders)
+    void print_event_dispatchers_table(code_generation_context_t & ctx) const
+    {
+        ctx.output.format("{}static constexpr event_dispatch_fn event_dispatchers[] {{", whitespace{ctx.indent_size * ctx.indent_level});
+        bool is_first = true;
+        for (const auto & msg : msg_collection_incoming)
+        {
+            ctx.output.format("{}&dispatch_{}", is_first ? "" : ", ", msg.name);
+            is_first = false;
+        }
+        ctx.output.write("};\n");
+
+        ctx.output.format("{}static constexpr interface_descriptor descriptor {{event_dispatchers, {}, event_signatures, {}}};\n"
+        , whitespace{ctx.indent_size * ctx.indent_level}
+        , has_fd_events() ? "event_fd_counts" : "{}"
+        , has_coalescing_rules() ? "event_coalescing_rules" : "{}");
     }
 
     void print_fw_declaration(code_generation_context_t & ctx) const
     {
         ctx.output.format("{}struct {};\n", whitespace{ctx.indent_size * ctx.indent_level}, name);
+        if (!msg_collection_incoming.empty()) ctx.output.format("{}struct {}_handled;\n", whitespace{ctx.indent_size * ctx.indent_level}, name);
     }
 
     void print_definition(code_generation_context_t & ctx) const
@@ -245,6 +266,7 @@ struct interface_t : element_t
             "{0}public: // interface constants\n"
             "{1}static constexpr std::string_view interface_name{{\"{5}\"}};\n"
             "{1}static constexpr version_t interface_version = {4};\n"
+            "{9}"
             // "{1}\n"
             // "{0}public: // static interface data\n"
             // "{1}static static_data_t static_data;\n"
@@ -252,6 +274,10 @@ struct interface_t : element_t
             "{0}public: // virtual getters\n"
             "{1}std::string_view get_interface_name() const override {{ return interface_name; }}\n"
             // "{1}static_data_t & get_interface_static_data() override {{ return static_data; }}\n"
+            "{6}"
+            "{7}"
+            "{8}"
+            "{10}"
             "\n"
             "{0}public: // constructor\n"
             "{1}{3}(engine & eng)\n"
@@ -267,7 +293,12 @@ struct interface_t : element_t
         , whitespace{ctx.indent_size * (ctx.indent_level + 2)}
         , name
         , version
-        , original_name);
+        , original_name
+        , has_fd_events() ? format_event_fd_counts(ctx) : std::string{}
+        , msg_collection_incoming.empty() ? std::string{} : format_event_signatures(ctx)
+        , msg_collection_incoming.empty() ? std::string{} : format_interface_descriptor_getter(ctx, "override")
+        , msg_collection_incoming.empty() ? std::string{} : format_event_opcodes(ctx)
+        , format_event_coalescing(ctx));
 
 
         // enums (type aliases)
@@ -317,6 +348,7 @@ struct interface_t : element_t
             ctx.indent_level++;
             for (const auto & request : msg_collection_outgoing)
                 request.print_declaration(ctx);
+            print_awaitable_requests_declarations(ctx);
             ctx.indent_level--;
 
             ctx.output.put('\n');
@@ -350,12 +382,19 @@ struct interface_t : element_t
         }
 
 
-        ctx.output.format(""
-            "{}protected: // used internally for dispatching events\n"
-            "{}void parse_and_dispatch_event(std::span<const char>) override{}\n"
-        , whitespace{ctx.indent_size * ctx.indent_level}
-        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
-        , msg_collection_incoming.empty() ? " {} // no events" : ";");
+        // event decoders (defined in the source file)
+        if (!msg_collection_incoming.empty())
+        {
+            ctx.output.format(""
+                "{}protected: // used internally for dispatching events (decoders indexed by opcode)\n"
+            , whitespace{ctx.indent_size * ctx.indent_level});
+
+            ctx.indent_level++;
+            for (const auto & msg : msg_collection_incoming)
+                ctx.output.format("{}static void dispatch_{}(interface & object, std::span<const char> buf);\n", whitespace{ctx.indent_size * ctx.indent_level}, msg.name);
+            print_event_dispatchers_table(ctx);
+            ctx.indent_level--;
+        }
 
         // for (const auto & event : server_to_client_msg_collection)
         //     event.print_declaration_r(ctx);
@@ -366,6 +405,346 @@ struct interface_t : element_t
         ctx.current_interface_ptr = {};
     }
 
+    // Static (CRTP) dispatch class `<name>_base<Derived>`, generated for the interfaces given with `--static-dispatch`.
+    // Its decoders call `Derived::on_<event>` (a qualified, non-virtual call), so handlers can be inlined.
+    // Events not handled by `Derived` go to the default handlers of the interface.
+    void print_static_dispatch_base(code_generation_context_t & ctx) const
+    {
+        if (msg_collection_incoming.empty() || !ctx.static_dispatch_interface_names.contains(original_name)) return;
+
+        ctx.current_interface_ptr = this;
+
+        ctx.output.format(""
+            "\n\n"
+            "{0}// INTERFACE {4} (static dispatch)\n"
+            "{0}// Events are dispatched to `Derived::on_<event>` without virtual calls.\n"
+            "{0}// Handlers of `Derived` hide the virtual ones and must be accessible from this class (public, or friend of `Derived`).\n"
+            "{0}template <class Derived>\n"
+            "{0}struct {3}_base : {3} {{\n"
+            "{0}public: // events not handled by `Derived` (e.g. to ignore them: `eng.set_ignored_events(obj, obj.unhandled_events())`)\n"
+            "{1}static constexpr event_mask_t unhandled_events()\n"
+            "{1}{{\n"
+            "{6}"
+            "{1}}}\n"
+            "\n"
+            "{0}public: // virtual getters\n"
+            "{5}"
+            "\n"
+            "{0}public: // constructor\n"
+            "{1}{3}_base(engine & eng)\n"
+            "{2}: {3}{{eng}}\n"
+            "{1}{{ }}\n"
+            "\n"
+            "{0}protected: // used internally for dispatching events (decoders indexed by opcode)\n"
+        , whitespace{ctx.indent_size * ctx.indent_level}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 2)}
+        , name
+        , original_name
+        , format_interface_descriptor_getter(ctx, "final")
+        , format_unhandled_events(ctx, handler_call_t::static_call));
+
+        ctx.indent_level++;
+        for (const auto & msg : msg_collection_incoming)
+        {
+            ctx.output.format("{}static void dispatch_{}(interface & object, std::span<const char> buf)\n", whitespace{ctx.indent_size * ctx.indent_level}, msg.name);
+            print_event_decoder_body(ctx, msg, std::format("{}_base", name), handler_call_t::static_call);
+        }
+        print_event_dispatchers_table(ctx);
+        ctx.indent_level--;
+
+        ctx.output.format("{}}};// {}_base\n", whitespace{ctx.indent_size * ctx.indent_level}, name);
+
+        ctx.current_interface_ptr = {};
+    }
+
+    // Handled class `<name>_handled`: events are dispatched to callables assigned at runtime (no subclassing needed).
+    // Each event has a slot in `handlers`, an `inplace_function` (the callable is stored in place: no allocation).
+    // Its decoders call the slots directly. Events without a handler go to the virtual handlers
+    // (the defaults of the interface, or the overrides of a subclass).
+    void print_handled_class(code_generation_context_t & ctx) const
+    {
+        if (msg_collection_incoming.empty()) return;
+
+        ctx.current_interface_ptr = this;
+
+        ctx.output.format(""
+            "\n\n"
+            "{0}// INTERFACE {4} (handled)\n"
+            "{0}// Events are dispatched to the callables in `handlers` (assignable at any time, stored without allocations).\n"
+            "{0}// Events without a handler go to the virtual handlers (the defaults of the interface, or the overrides of a subclass).\n"
+            "{0}struct {3}_handled : {3} {{\n"
+            "{0}public: // event handlers\n"
+            "{1}struct handlers_t {{\n"
+        , whitespace{ctx.indent_size * ctx.indent_level}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 2)}
+        , name
+        , original_name);
+
+        ctx.indent_level += 2;
+        for (const auto & msg : msg_collection_incoming)
+        {
+            ctx.output.format("{}inplace_function<", whitespace{ctx.indent_size * ctx.indent_level});
+            msg.print_handler_signature(ctx);
+            ctx.output.format("> on_{};\n", msg.name);
+        }
+        ctx.indent_level -= 2;
+
+        ctx.output.format(""
+            "{1}}} handlers{{}};\n"
+            "\n"
+            "{1}// events without a handler (e.g. to ignore them: `eng.set_ignored_events(obj, obj.unhandled_events())`)\n"
+            "{1}// overrides of a subclass are not seen: their events are counted as unhandled\n"
+            "{1}event_mask_t unhandled_events() const\n"
+            "{1}{{\n"
+            "{5}"
+            "{1}}}\n"
+            "\n"
+            "{0}public: // virtual getters\n"
+            "{4}"
+            "\n"
+            "{0}public: // constructor\n"
+            "{1}{3}_handled(engine & eng)\n"
+            "{2}: {3}{{eng}}\n"
+            "{1}{{ }}\n"
+            "\n"
+            "{0}protected: // used internally for dispatching events (decoders indexed by opcode)\n"
+        , whitespace{ctx.indent_size * ctx.indent_level}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , whitespace{ctx.indent_size * (ctx.indent_level + 2)}
+        , name
+        , format_interface_descriptor_getter(ctx, "final")
+        , format_unhandled_events(ctx, handler_call_t::handlers));
+
+        ctx.indent_level++;
+        for (const auto & msg : msg_collection_incoming)
+            ctx.output.format("{}static void dispatch_{}(interface & object, std::span<const char> buf);\n", whitespace{ctx.indent_size * ctx.indent_level}, msg.name);
+        print_event_dispatchers_table(ctx);
+        ctx.indent_level--;
+
+        ctx.output.format("{}}};// {}_handled\n", whitespace{ctx.indent_size * ctx.indent_level}, name);
+
+        ctx.current_interface_ptr = {};
+    }
+
+    // decoders of the handled class (source file)
+    void print_handled_src(code_generation_context_t & ctx) const
+    {
+        for (const auto & msg : msg_collection_incoming)
+        {
+            ctx.output.format(""
+                "\n"
+                "{0}void {1}_handled::dispatch_{2}(interface & object, std::span<const char> buf)\n"
+            , whitespace{ctx.indent_size * ctx.indent_level}
+            , name
+            , msg.name);
+
+            print_event_decoder_body(ctx, msg, std::format("{}_handled", name), handler_call_t::handlers);
+        }
+    }
+
+    // true when some event carries file descriptors
+    bool has_fd_events() const
+    {
+        return std::ranges::any_of(msg_collection_incoming, [](const auto & msg){
+            return std::ranges::any_of(msg.args, [](const auto & arg){ return arg.is_fd(); });
+        });
+    }
+
+    // table of file descriptors carried by each event (used by the engine to queue and discard file descriptors)
+    std::string format_event_fd_counts(const code_generation_context_t & ctx) const
+    {
+        std::string counts;
+        for (const auto & msg : msg_collection_incoming)
+        {
+            if (!counts.empty()) counts += ", ";
+            counts += std::to_string(std::ranges::count_if(msg.args, [](const auto & arg){ return arg.is_fd(); }));
+        }
+
+        return std::format(""
+            "{0}static constexpr std::uint8_t event_fd_counts[] {{{1}}};\n"
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , counts);
+    }
+
+    // wire signature of each event (used by the engine to validate untrusted input)
+    std::string format_event_signatures(const code_generation_context_t & ctx) const
+    {
+        std::string signatures;
+        for (const auto & msg : msg_collection_incoming)
+        {
+            if (!signatures.empty()) signatures += ", ";
+            signatures += '"';
+            for (const auto & arg : msg.args) signatures += arg.wire_signature();
+            signatures += '"';
+        }
+
+        return std::format(""
+            "{0}static constexpr std::string_view event_signatures[] {{{1}}};\n"
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , signatures);
+    }
+
+    // Requests that create a `wl_callback` can be awaited by coroutines (see `callback_awaitable`).
+    // The awaitable sends the request and embeds the callback object.
+    struct awaitable_request_t
+    {
+        std::string_view interface_name;
+        std::string_view request_name;
+        std::string_view awaitable_name;
+    };
+
+    static constexpr awaitable_request_t awaitable_requests[] {
+        {"wl_display", "sync", "roundtrip"},
+        {"wl_surface", "frame", "next_frame"},
+    };
+
+    auto find_awaitable_requests() const
+    {
+        return std::views::filter(awaitable_requests, [this](const auto & x){ return x.interface_name == original_name; });
+    }
+
+    void print_awaitable_requests_declarations(code_generation_context_t & ctx) const
+    {
+        for (const auto & x : find_awaitable_requests())
+            ctx.output.format(""
+                "{0}// `{1}` awaited by a coroutine: `co_await` returns the data of the `done` event of the callback\n"
+                "{0}dd99::wayland::callback_awaitable<callback_handled> {2}();\n"
+            , whitespace{ctx.indent_size * ctx.indent_level}
+            , x.request_name
+            , x.awaitable_name);
+    }
+
+    // defined after the handled classes (the awaitable embeds a `callback_handled`)
+    void print_awaitable_requests_definitions(code_generation_context_t & ctx) const
+    {
+        for (const auto & x : find_awaitable_requests())
+            ctx.output.format(""
+                "\n"
+                "{0}inline dd99::wayland::callback_awaitable<callback_handled> {2}::{3}()\n"
+                "{0}{{\n"
+                "{1}return dd99::wayland::callback_awaitable<callback_handled>{{m_engine, [this](callback_handled & callback_){{ {4}(callback_); }}}};\n"
+                "{0}}}\n"
+            , whitespace{ctx.indent_size * ctx.indent_level}
+            , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+            , name
+            , x.awaitable_name
+            , x.request_name);
+    }
+
+    // Events merged by the coalescing stage of the engine (see `engine::set_event_coalescing`):
+    // the high-rate input events of the core protocol
+    struct coalescing_rule_t
+    {
+        std::string_view interface_name;
+        std::string_view event_name;
+        std::string_view mode;          // `latest` or `sum`
+        std::string_view key_arg;       // events with a different value of this argument are not merged (none when empty)
+        std::string_view sum_arg;       // summed argument (`sum`)
+    };
+
+    static constexpr coalescing_rule_t coalescing_rules[] {
+        {"wl_pointer", "motion", "latest", "", ""},
+        {"wl_pointer", "axis", "sum", "axis", "value"},
+        {"wl_pointer", "axis_discrete", "sum", "axis", "discrete"},
+        {"wl_pointer", "axis_value120", "sum", "axis", "value120"},
+        {"wl_touch", "motion", "latest", "id", ""},
+    };
+
+    // offset of an argument in the message (header included)
+    // only arguments before any string or array have a fixed offset
+    static std::size_t argument_offset(const message_t & msg, std::string_view arg_name)
+    {
+        std::size_t offset = 8;
+        for (const auto & arg : msg.args)
+        {
+            if (arg.name == arg_name) return offset;
+
+            const auto signature = arg.wire_signature();
+            if (signature.ends_with('s') || signature.ends_with('a')) break;
+            if (!signature.ends_with('h')) offset += 4;
+        }
+        throw std::runtime_error{std::format("coalescing rule: no fixed offset for argument {} of event {}", arg_name, msg.original_name)};
+    }
+
+    // true when some event has a coalescing rule
+    bool has_coalescing_rules() const
+    {
+        return std::ranges::any_of(msg_collection_incoming, [this](const auto & msg){
+            return std::ranges::any_of(coalescing_rules, [&](const auto & r){ return r.interface_name == original_name && r.event_name == msg.original_name; });
+        });
+    }
+
+    // table of coalescing rules of the events (empty for interfaces without coalesced events)
+    std::string format_event_coalescing(const code_generation_context_t & ctx) const
+    {
+        if (!has_coalescing_rules()) return {};
+
+        std::string rules;
+        for (const auto & msg : msg_collection_incoming)
+        {
+            if (!rules.empty()) rules += ", ";
+
+            auto rule = std::ranges::find_if(coalescing_rules, [&](const auto & r){ return r.interface_name == original_name && r.event_name == msg.original_name; });
+            if (rule == std::ranges::end(coalescing_rules))
+            {
+                rules += "{}";
+                continue;
+            }
+
+            rules += std::format("{{event_coalescing::mode_t::{}, {}, {}}}"
+            , rule->mode
+            , rule->key_arg.empty() ? std::string{"event_coalescing::no_key"} : std::to_string(argument_offset(msg, rule->key_arg))
+            , rule->sum_arg.empty() ? 0 : argument_offset(msg, rule->sum_arg));
+        }
+
+        return std::format(""
+            "{0}static constexpr event_coalescing event_coalescing_rules[] {{{1}}};\n"
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , rules);
+    }
+
+    // event opcodes (used to build event masks, see `engine::set_ignored_events`)
+    std::string format_event_opcodes(const code_generation_context_t & ctx) const
+    {
+        std::string opcodes;
+        for (const auto & msg : msg_collection_incoming)
+            opcodes += std::format("{}{} = {}", opcodes.empty() ? "" : ", ", msg.name, msg.opcode);
+
+        return std::format(""
+            "{}enum class events : opcode_t {{{}}};\n"
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , opcodes);
+    }
+
+    // body of `unhandled_events()`: mask of the events that would reach the default handlers of the interface
+    std::string format_unhandled_events(const code_generation_context_t & ctx, handler_call_t handler_call) const
+    {
+        const auto indent = whitespace{ctx.indent_size * (ctx.indent_level + 2)};
+
+        std::string body = std::format("{}event_mask_t mask = 0;\n", indent);
+        for (const auto & msg : msg_collection_incoming)
+        {
+            // static dispatch: `Derived` does not declare the handler
+            if (handler_call == handler_call_t::static_call)
+                body += std::format("{0}if (std::is_same_v<decltype(&Derived::on_{1}), decltype(&{2}_base::on_{1})>) mask |= event_mask(events::{1});\n", indent, msg.name, name);
+            else
+                body += std::format("{0}if (!handlers.on_{1}) mask |= event_mask(events::{1});\n", indent, msg.name);
+        }
+        body += std::format("{}return mask;\n", indent);
+        return body;
+    }
+
+    // getter of the event tables (`override`, or `final` for static dispatch and handled classes)
+    std::string format_interface_descriptor_getter(const code_generation_context_t & ctx, std::string_view specifier) const
+    {
+        return std::format(""
+            "{}const interface_descriptor & get_interface_descriptor() const {} {{ return descriptor; }}\n"
+        , whitespace{ctx.indent_size * (ctx.indent_level + 1)}
+        , specifier);
+    }
+
     void print_member_definitions_section(code_generation_context_t & ctx) const
     {
         ctx.current_interface_ptr = this;
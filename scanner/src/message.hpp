@@ -3,7 +3,10 @@
 #include "argument.hpp"
 #include "element.hpp"
 #include "formatting.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <string_view>
 #include <unistd.h>
 
 
@@ -12,6 +15,7 @@ struct message_t : element_t
 {
     int since;
     int opcode;
+    bool is_destructor;
     std::vector<argument_t> args{};
     // std::size_t ret_index = std::numeric_limits<std::size_t>::max();
 
@@ -22,6 +26,7 @@ struct message_t : element_t
         : element_t{node}
         , since{node.attribute("since").as_int(1)}
         , opcode{opcode_}
+        , is_destructor{std::string_view{node.attribute("type").value()} == "destructor"}
     {
         for (const auto arg_node : node.children("arg"))
         {
@@ -58,11 +63,15 @@ struct message_t : element_t
     {
         // This function generates the defautl definition for the virtual event callbacks
         // This is used to log wayland events
+        // The handler owns the file descriptors it receives: the default one closes them
         print_virtual_callback_prototype(ctx, outside_class);
 
         if (!ctx.generate_message_logs)
         {
-            ctx.output.write(" {}");
+            ctx.output.write(" {");
+            for (const auto & arg : args)
+                if (arg.is_fd()) ctx.output.format(" ::close({});", format::argument_name_cpp{ctx, arg});
+            ctx.output.write(std::ranges::any_of(args, [](const auto & arg){ return arg.is_fd(); }) ? " }" : "}");
             return;
         }
 
@@ -140,6 +149,9 @@ struct message_t : element_t
         }
         ctx.output.format("{});\n", whitespace{ctx.indent_size * ctx.indent_level});
 
+        for (const auto & arg : args)
+            if (arg.is_fd()) ctx.output.format("{}::close({});\n", whitespace{ctx.indent_size * ctx.indent_level}, format::argument_name_cpp{ctx, arg});
+
         ctx.indent_level--;
 
         // closing brace
@@ -165,6 +177,21 @@ struct message_t : element_t
         ctx.output.put(')');
     }
 
+    // function type of the event handler (the parameters of `on_<event>`), e.g. `void(std::uint32_t, surface *)`
+    void print_handler_signature(code_generation_context_t & ctx) const
+    {
+        ctx.output.write("void(");
+        bool first_arg = true;
+        for (const auto & arg : args)
+        {
+            if (!first_arg) ctx.output.write(", ");
+            if (arg.is_new_interface()) ctx.output.write("object_id_t");
+            else ctx.output.format("{}{}", format::argument_type_cpp{ctx, arg}, arg.is_existent_interface() ? " *" : "");
+            first_arg = false;
+        }
+        ctx.output.put(')');
+    }
+
     void print_declaration(code_generation_context_t & ctx) const
     {
         print_prototype(ctx, {});
@@ -255,7 +282,7 @@ struct message_t : element_t
             ctx.output.write("};\n");
         }
 
-        // bind interfaces to new object_ids
+        // bind interfaces to new object_ids (new objects inherit the event queue of this object)
         for (std::size_t i = 0; i < args.size(); ++i)
         {
             if (!args[i].is_new_interface()) continue;
@@ -263,7 +290,7 @@ struct message_t : element_t
             if (args[i].interface.empty())
             {
                 ctx.output.format(""
-                    "{0}auto new_{1} = m_engine.bind_interface({1}, {2});\n"
+                    "{0}auto new_{1} = m_engine.bind_interface({1}, {2}, *this);\n"
                 , whitespace{ctx.indent_size * ctx.indent_level}
                 , format::argument_name_cpp{ctx, args[i]}
                 , format::argument_name_cpp{ctx, args[i-1]}
@@ -272,7 +299,7 @@ struct message_t : element_t
             else
             {
                 ctx.output.format(""
-                    "{0}auto new_{1} = m_engine.bind_interface({1}, m_version);\n"
+                    "{0}auto new_{1} = m_engine.bind_interface({1}, m_version, *this);\n"
                 , whitespace{ctx.indent_size * ctx.indent_level}
                 , format::argument_name_cpp{ctx, args[i]}
                 );
@@ -300,30 +327,34 @@ struct message_t : element_t
         //     }
         // }
         
-        ctx.output.format("{}", whitespace{ctx.indent_size * ctx.indent_level});
-        ctx.output.write("send_wayland_message(opcode, ");
-        if (fds_count > 0) ctx.output.write("fds");
-        else ctx.output.write("{}");
-        // passing arguments to `send_wayland_message`
-        for (const auto & arg : args)
+        if (is_fixed_size()) print_fixed_size_message_send(ctx, fds_count > 0);
+        else
         {
-            // file descriptors are not passed as arguments here
-            if (arg.is_fd()) continue;
+            ctx.output.format("{}", whitespace{ctx.indent_size * ctx.indent_level});
+            ctx.output.write("send_wayland_message(opcode, ");
+            if (fds_count > 0) ctx.output.write("fds");
+            else ctx.output.write("{}");
+            // passing arguments to `send_wayland_message`
+            for (const auto & arg : args)
+            {
+                // file descriptors are not passed as arguments here
+                if (arg.is_fd()) continue;
 
-            ctx.output.write(", ");
+                ctx.output.write(", ");
 
-            // new-id is prefixed by interface name string and version when not explicit by protocol
-            // if (arg.base_type == argument_type_t::T_NEWID && arg.interface.empty())
-            // {
-            //     ctx.output.format("{0}_interface, {0}_version, "
-            //     , format::argument_name_cpp{ctx, arg});
-            // }
+                // new-id is prefixed by interface name string and version when not explicit by protocol
+                // if (arg.base_type == argument_type_t::T_NEWID && arg.interface.empty())
+                // {
+                //     ctx.output.format("{0}_interface, {0}_version, "
+                //     , format::argument_name_cpp{ctx, arg});
+                // }
 
-            if (arg.is_new_interface()) ctx.output.write("new_");
-            ctx.output.format("{}", format::argument_name_cpp{ctx, arg});
+                if (arg.is_new_interface()) ctx.output.write("new_");
+                ctx.output.format("{}", format::argument_name_cpp{ctx, arg});
+            }
+            // end of `send_wayland_message` invocation
+            ctx.output.write(");\n");
         }
-        // end of `send_wayland_message` invocation
-        ctx.output.write(");\n");
 
         if (ctx.generate_message_logs)
         {
@@ -404,6 +435,10 @@ struct message_t : element_t
             ctx.output.format("{});\n", whitespace{ctx.indent_size * ctx.indent_level});
         }
 
+        // objects made by `engine::create` are destroyed by their destructor request
+        if (is_destructor)
+            ctx.output.format("\n{}m_engine.release_interface(*this);\n", whitespace{ctx.indent_size * ctx.indent_level});
+
         ctx.indent_level--;
 
         // closing brace
@@ -412,7 +447,90 @@ struct message_t : element_t
         , whitespace{ctx.indent_size * ctx.indent_level});
     }
 
+    // true when the wire size of the message does not depend on argument values
+    // (no strings or arrays; file descriptors are not part of the wire data)
+    bool is_fixed_size() const
+    {
+        return std::ranges::none_of(args, [](const auto & arg){ return arg.is_string() || arg.is_array(); });
+    }
+
+    // wire size of a fixed-size message (header included)
+    std::size_t fixed_wire_size() const
+    {
+        assert(is_fixed_size());
+        return 8 + 4 * static_cast<std::size_t>(std::ranges::count_if(args, [](const auto & arg){ return !arg.is_fd(); }));
+    }
+
 private:
+    // Fixed-size requests are not marshalled argument by argument.
+    // A struct with the exact wire layout is generated (checked with static_assert) and the whole message is stored at once.
+    void print_fixed_size_message_send(code_generation_context_t & ctx, bool has_fds) const
+    {
+        const auto indent = whitespace{ctx.indent_size * ctx.indent_level};
+        const auto indent_member = whitespace{ctx.indent_size * (ctx.indent_level + 1)};
+
+        // layout definition
+        ctx.output.format(""
+            "{0}struct alignas(std::uint32_t) wire_layout_t\n"
+            "{0}{{\n"
+            "{1}object_id_t object_id;\n"
+            "{1}std::uint32_t size_and_opcode;\n"
+        , indent
+        , indent_member);
+
+        for (const auto & arg : args)
+        {
+            if (arg.is_fd()) continue;
+
+            std::string_view wire_type;
+            if (arg.is_interface()) wire_type = "object_id_t";
+            else if (arg.is_enum()) wire_type = "std::uint32_t";
+            else if (arg.type() == argument_type_t::T_INT || arg.type() == argument_type_t::T_FIXED) wire_type = "std::int32_t";
+            else wire_type = "std::uint32_t";
+
+            ctx.output.format(""
+                "{}{} {};\n"
+            , indent_member
+            , wire_type
+            , format::argument_name_cpp{ctx, arg});
+        }
+
+        ctx.output.format(""
+            "{0}}};\n"
+            "{0}static_assert(sizeof(wire_layout_t) == {1});\n"
+            "{0}static_assert(alignof(wire_layout_t) == alignof(std::uint32_t));\n"
+            "\n"
+            "{0}send_wayland_message_layout<wire_layout_t>({2}, {{\n"
+            "{3}m_object_id,\n"
+            "{3}static_cast<std::uint32_t>((sizeof(wire_layout_t) << 16) | opcode),\n"
+        , indent
+        , fixed_wire_size()
+        , has_fds ? "fds" : "{}"
+        , indent_member);
+
+        for (const auto & arg : args)
+        {
+            if (arg.is_fd()) continue;
+
+            ctx.output.format("{}", indent_member);
+
+            if (arg.is_new_interface())
+                ctx.output.format("new_{}", format::argument_name_cpp{ctx, arg});
+            else if (arg.is_existent_interface())
+                ctx.output.format("reinterpret_cast<const interface &>({}).get_id()", format::argument_name_cpp{ctx, arg});
+            else if (arg.is_enum())
+                ctx.output.format("static_cast<std::uint32_t>({})", format::argument_name_cpp{ctx, arg});
+            else if (arg.type() == argument_type_t::T_FIXED)
+                ctx.output.format("std::bit_cast<std::int32_t>({})", format::argument_name_cpp{ctx, arg});
+            else
+                ctx.output.format("{}", format::argument_name_cpp{ctx, arg});
+
+            ctx.output.write(",\n");
+        }
+
+        ctx.output.format("{}}});\n", indent);
+    }
+
     void print_argument_name(code_generation_context_t & ctx, const argument_t & arg) const
     {
         arg.print_name(ctx);
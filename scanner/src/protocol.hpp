@@ -55,6 +55,11 @@ struct protocol_t : element_t
             x.print_member_definitions_section(ctx);
         }
 
+        // handled and static dispatch classes (after all interfaces are defined)
+        for (const auto & x : interfaces) x.print_handled_class(ctx);
+        for (const auto & x : interfaces) x.print_static_dispatch_base(ctx);
+        for (const auto & x : interfaces) x.print_awaitable_requests_definitions(ctx);
+
         ctx.indent_level--;
         print_namespace_end(ctx);
 
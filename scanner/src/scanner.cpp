@@ -62,6 +62,7 @@ struct scan_args
     enum class visibility_t {PUBLIC, PRIVATE} visibility {visibility_t::PRIVATE};
     enum class side_t {SERVER, CLIENT} side {side_t::CLIENT};
     bool generate_message_logs = true;
+    std::set<std::string_view> static_dispatch_interface_names{}; // interfaces that get a static (CRTP) dispatch class
 
     scan_args(int argc, char** argv)
     {
@@ -74,6 +75,7 @@ struct scan_args
         //  -s  --server-side   server side
         //  -c  --no-comments   do not output comments
         //      --include=<hdr> add "#include hdr"
+        //      --static-dispatch=<iface>[,<iface>...]  generate static dispatch classes
 
         commandline = argv[0];
 
@@ -109,6 +111,23 @@ struct scan_args
                     }
                     forced_includes.push_back(v.substr(8));
                 }
+                else if (v.starts_with("static-dispatch="))
+                {
+                    if (v.size() == 16)
+                    {
+                        // leaving space between the option and the value is not allowed
+                        print_help = true;
+                        std::format_to(std::ostream_iterator<char>{std::cerr}, "Error: Whitespace not allowed after option with value: \"{}\"", v);
+                    }
+
+                    // comma-separated list of interface names (as in the xml)
+                    for (auto names = v.substr(16); !names.empty();)
+                    {
+                        auto comma = names.find(',');
+                        if (auto name = names.substr(0, comma); !name.empty()) static_dispatch_interface_names.insert(name);
+                        names = (comma == std::string_view::npos) ? std::string_view{} : names.substr(comma + 1);
+                    }
+                }
                 else if (v.starts_with("main-include="))
                 {
                     if (v.size() == 13)
@@ -176,7 +195,9 @@ inline void print_help(scan_args & args)
         "    {:2}    {:15}        {}\n"
         "    {:2}    {:15}        {}\n"
         "    {:2}    {:15}        {}\n"
-        "    {:2}    {:15}        {}\n",
+        "    {:2}    {:15}        {}\n"
+        "    {:2}    {:15}        {}\n"
+        "    {:2}    {:15}        {}\n"
         "    {:2}    {:15}        {}\n",
     args.commandline,
     "-h", "--help"                  , "print this help",
@@ -185,7 +206,8 @@ inline void print_help(scan_args & args)
     "-c", "--no-comments"           , "Do not output comments to generated files",
     ""  , "--no-message-logs"       , "Do not generate logging code for wayland messages",
     ""  , "--include=<inc>"         , "Add \"#include inc\" to generated header",
-    ""  , "--main-include=<inc>"    , "Use \"#include inc\" instead of default dd99 wayland library header"
+    ""  , "--main-include=<inc>"    , "Use \"#include inc\" instead of default dd99 wayland library header",
+    ""  , "--static-dispatch=<ifaces>", "Also generate `<name>_base<Derived>` classes (events dispatched without virtual calls) for these comma-separated interfaces"
     );
 }
 
@@ -297,6 +319,7 @@ int main(int argc, char ** argv)
             .output = hdr_buffered_output,
             .generate_message_logs = args.generate_message_logs,
             .external_inerface_names = external_interface_names,
+            .static_dispatch_interface_names = args.static_dispatch_interface_names,
             .protocols = protocols,
             .name_index = name_index,
         };
@@ -369,6 +392,7 @@ int main(int argc, char ** argv)
             .output = src_buffered_output,
             .generate_message_logs = args.generate_message_logs,
             .external_inerface_names = external_interface_names,
+            .static_dispatch_interface_names = args.static_dispatch_interface_names,
             .protocols = protocols,
             .name_index = name_index,
         };
@@ -2,6 +2,8 @@
 #include "dd99-wayland-client-protocol-wayland.hpp"
 #include "dd99-wayland-client-protocol-xdg-shell.hpp"
 #include <dd99/wayland/wayland_client.hpp>
+#include <dd99/wayland/mirrored_ring_buffer.hpp>
+#include <dd99/wayland/scm_rights.hpp>
 
 #include <asio.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
@@ -71,88 +73,6 @@ auto connect_to_wayland_server(asio::io_context & io_ctx)
 
 
 
-// a callback that calls any custom callable
-template <class F>
-struct callback final : pw::callback
-{
-    callback(dd99::wayland::engine & eng, F && f)
-        : pw::callback{eng}
-        , m_f{f}
-    { }
-
-    void on_done(std::uint32_t serial) override { pw::callback::on_done(serial); m_f(); }
-
-    F m_f;
-};
-
-// a callback that calls a member function
-template <class T>
-struct callback_member final : pw::callback
-{
-    using signature = void(T*, std::uint32_t);
-    using instance_t = T;
-
-    callback_member(dd99::wayland::engine & eng, T * this_ptr, void (instance_t::* fnct_ptr)(std::uint32_t))
-        : pw::callback{eng}
-        , m_i{this_ptr}
-        , m_f{fnct_ptr}
-    { }
-
-    void on_done(std::uint32_t serial) override { pw::callback::on_done(serial); (m_i->*m_f)(serial); }
-
-    instance_t * m_i;
-    void (instance_t::* m_f)(std::uint32_t);
-};
-
-
-template <asio::completion_token_for<void(asio::error_code, std::uint32_t)> CompletionToken>
-struct asio_callback : pw::callback
-{
-    using async_result_type = asio::async_result<std::decay_t<CompletionToken>, void(asio::error_code, std::uint32_t)>;
-    using result_type = async_result_type::return_type;
-    using handler_type = async_result_type::handler_type;
-
-    asio_callback(dd99::wayland::engine & eng, CompletionToken && token)
-        : pw::callback{eng}
-    {
-        result = asio::async_initiate<CompletionToken, void(asio::error_code, std::uint32_t)>(
-            [](auto handler, std::optional<handler_type> & instance_handler, std::optional<asio::executor_work_guard<asio::any_io_executor>> & instance_work_guard)
-            {
-                auto ex = asio::get_associated_executor(handler);
-                instance_work_guard.emplace(asio::make_work_guard(ex));
-                instance_handler.emplace(std::move(handler));
-            }, token, std::ref(handler), std::ref(work_guard));
-    }
-
-    auto get_async()
-    {
-        auto t = std::move(*result);
-        result.reset();
-        return std::move(t);
-    }
-
-protected:
-    void on_done(std::uint32_t callback_data) override
-    {
-        // (*work_guard).reset();
-        work_guard.reset();
-        if (handler)
-        {
-            // std::move(*handler)({}, callback_data); // somehow this causes a crash
-            asio::dispatch([=, handler = std::move(*handler)]() mutable { handler({}, callback_data); });
-            handler.reset();
-        }
-    }
-
-private:
-    std::optional<result_type> result;
-    std::optional<handler_type> handler;
-    std::optional<asio::executor_work_guard<asio::any_io_executor>> work_guard;
-};
-template <asio::completion_token_for<void(asio::error_code, std::uint32_t)> CompletionToken>
-asio_callback(dd99::wayland::engine &, CompletionToken &&) -> asio_callback<CompletionToken>;
-
-
 struct xdg_toplevel final : wlp::xdg_shell::xdg_toplevel
 {
     using wlp::xdg_shell::xdg_toplevel::xdg_toplevel;
@@ -252,39 +172,25 @@ struct engine final : dd99::wayland::engine
         // m_sock.flush();
         // asio::write(m_sock.next_layer(), asio::buffer("something"));
 
-        ::msghdr msg {};
-        ::cmsghdr * cmsg;
-
         ::iovec io{
             .iov_base = const_cast<char *>(data.data()),
             .iov_len = data.size(),
         };
 
-        auto data_size = sizeof(int) * ancillary_output_fd_collection.size();
-        auto fd_buf_size = CMSG_SPACE(data_size);
-
-        auto fd_buf = new (std::align_val_t{alignof(::cmsghdr)}) char[fd_buf_size];
-
+        ::msghdr msg {};
         msg.msg_iov = &io;
         msg.msg_iovlen = 1;
-        msg.msg_control = fd_buf;
-        msg.msg_controllen = fd_buf_size;
-        cmsg = CMSG_FIRSTHDR(&msg);
-        cmsg->cmsg_level = SOL_SOCKET;
-        cmsg->cmsg_type = SCM_RIGHTS;
-        cmsg->cmsg_len = CMSG_LEN(data_size);
-        std::memcpy(CMSG_DATA(cmsg), ancillary_output_fd_collection.data(), data_size);
+        m_scm_rights.attach(msg, ancillary_output_fd_collection);
 
         // auto r = sendmsg(m_sock.next_layer().native_handle(), &msg, 0);
         auto r = sendmsg(m_sock.native_handle(), &msg, 0);
 
-        operator delete[](fd_buf, std::align_val_t{alignof(::cmsghdr)});
-
         if (r == -1) throw std::system_error{{errno, std::system_category()}};
     }
 
 
     sock_type & m_sock;
+    dd99::wayland::scm_rights_buffer<> m_scm_rights; // reused for every write that carries file descriptors
 };
 
 
@@ -310,12 +216,9 @@ struct wayland_app
         , m_xdg_toplevel{m_engine}
         , m_shared_memory{boost::interprocess::create_only, shared_memory_filename.data(), boost::interprocess::read_write}
     {
-        m_buffer.reserve(1024*4);
-
         m_engine.bind_display(m_display);
         m_display.get_registry(m_registry);
-        m_callback.emplace(m_engine, this, &wayland_app::on_registry_sync);
-        m_display.sync(*m_callback);
+        create_window();
         // m_buffered_socket.flush();
     }
 
@@ -324,40 +227,34 @@ public:
     {
         // static std::ofstream binary_input_log{"binary_input_log"};
 
-        using std::memmove;
-
-        // make sure buffer has some space
-        m_previous_buffer_size = m_buffer.size();
-        auto freespace = m_buffer.capacity() - m_buffer.size();
-        if (freespace == 0) m_buffer.resize(m_buffer.size() + 1024*4);
-        else m_buffer.resize(m_buffer.capacity());
+        // the ring is mirrored in memory: free space and received data are always contiguous
+        auto window = m_input_buffer.write_window();
+        if (window.empty()) throw std::runtime_error{"input buffer is full"};
 
-        m_socket.async_read_some(asio::buffer(m_buffer.data() + m_previous_buffer_size, m_buffer.capacity() - m_previous_buffer_size),
+        m_socket.async_read_some(asio::buffer(window.data(), window.size()),
         [&](std::error_code ec, std::size_t n){
 
-            // binary_input_log.write(m_buffer.data() + m_previous_buffer_size, n);
-            // binary_input_log.flush();
-
             if (ec) throw std::system_error{ec};
 
-            m_buffer.resize(m_previous_buffer_size + n);
-            auto n_consumed = m_engine.process_input(m_buffer);
-            if (n_consumed != m_buffer.size()) memmove(m_buffer.data(), m_buffer.data() + n_consumed, m_buffer.size() - n_consumed);
-            m_buffer.resize(m_buffer.size() - n_consumed);
+            // a partial message waits in place until the rest arrives
+            m_input_buffer.commit(n);
+            m_input_buffer.consume(m_engine.process_input(m_input_buffer.read_window()));
             run();
         });
     }
 
 
 private:
-    void on_registry_sync(std::uint32_t cb_serial)
+    // resumed by `process_input` (see `run`)
+    dd99::wayland::detached_task create_window()
     {
-        m_callback.reset();
+        // the registry has announced its globals once the server answers
+        co_await m_display.roundtrip();
 
         if (!m_registry.compositor.get_id() || !m_registry.shm.get_id() || !m_registry.xdg_wm_base.get_id())
         {
             std::cerr << "server does not support some required interfaces\n";
-            return;
+            co_return;
         }
 
         struct pixel {
@@ -401,15 +298,12 @@ private:
 public:
     asio::local::stream_protocol::socket m_socket;
     asio::buffered_write_stream<decltype(m_socket) &> m_buffered_write_socket;
-    std::vector<char> m_buffer{};
-    std::size_t m_previous_buffer_size = 0;
+    dd99::wayland::mirrored_ring_buffer m_input_buffer{1024*64}; // fits the largest wayland message
 
     engine m_engine;
     display m_display;
     registry m_registry;
 
-    std::optional<callback_member<wayland_app>> m_callback;
-
     pw::shm_pool m_shm_pool;
     pw::buffer m_pixel_buffer;
     pw::surface m_surface;
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+
+
+// minimal checks for the unit tests (each test is an executable run by CTest)
+namespace dd99::wayland::test
+{
+
+    inline int failed_checks = 0;
+
+    inline void check(bool condition, const char * expression, const char * file, int line)
+    {
+        if (condition) return;
+        ++failed_checks;
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    }
+
+    // exit status of the test
+    inline int result() { return (failed_checks == 0) ? EXIT_SUCCESS : EXIT_FAILURE; }
+
+}
+
+#define DD99_CHECK(...) ::dd99::wayland::test::check((__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
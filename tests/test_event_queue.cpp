@@ -0,0 +1,162 @@
+// Events of queued objects are dispatched by `event_queue::dispatch_pending`, with their file descriptors.
+// When a handler throws, the events left in the queue are dropped and their file descriptors closed.
+// Object arguments are looked up when events are queued, so a queue can be dispatched by another thread than `process_input`.
+
+#include "check.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/event_queue.hpp>
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+
+
+
+namespace
+{
+
+    struct null_engine final : dd99::wayland::engine
+    {
+        void on_output(std::span<const char>, std::span<int>) override { }
+    };
+
+    struct keyboard final : pw::keyboard
+    {
+        using pw::keyboard::keyboard;
+
+        void on_keymap(std::uint32_t, int fd, std::uint32_t) override
+        {
+            fds.push_back(fd);
+            if (throw_on_keymap) throw std::runtime_error{"handler failed"};
+        }
+
+        void on_enter(std::uint32_t, pw::surface * surface, std::span<const char>) override { surfaces.push_back(surface); }
+
+        std::vector<int> fds{};
+        bool throw_on_keymap = false;
+        std::vector<pw::surface *> surfaces{};
+    };
+
+    // wl_keyboard.keymap: format, fd (not in the message), size
+    void append_keymap_event(std::vector<char> & input, dd99::wayland::object_id_t id)
+    {
+        const std::uint32_t words[] = {id, (16u << 16) | 0u, 1, 1024};
+        const auto offset = input.size();
+        input.resize(offset + sizeof(words));
+        std::memcpy(input.data() + offset, words, sizeof(words));
+    }
+
+    // wl_keyboard.enter: serial, surface, keys (empty array)
+    void append_enter_event(std::vector<char> & input, dd99::wayland::object_id_t id, dd99::wayland::object_id_t surface_id)
+    {
+        const std::uint32_t words[] = {id, (20u << 16) | 1u, 1, surface_id, 0};
+        const auto offset = input.size();
+        input.resize(offset + sizeof(words));
+        std::memcpy(input.data() + offset, words, sizeof(words));
+    }
+
+    int open_fd() { return ::open("/dev/null", O_RDONLY | O_CLOEXEC); }
+    bool is_open(int fd) { return ::fcntl(fd, F_GETFD) != -1; }
+
+}
+
+
+int main()
+{
+    null_engine eng;
+    pw::display display{eng};
+    eng.bind_display(display);
+    pw::registry registry{eng};
+    display.get_registry(registry);
+    pw::seat seat{eng};
+    registry.bind(1, "wl_seat", 1, seat);
+
+    dd99::wayland::event_queue queue{eng};
+    keyboard kbd{eng};
+    seat.get_keyboard(kbd);
+    eng.set_queue(kbd, &queue);
+
+    std::vector<char> input;
+    for (int i = 0; i < 3; ++i) append_keymap_event(input, kbd.get_id());
+    const int fds[] = {open_fd(), open_fd(), open_fd()};
+
+    // queued, not dispatched
+    DD99_CHECK(eng.process_input(input, fds) == input.size());
+    DD99_CHECK(kbd.fds.empty());
+    DD99_CHECK(queue.size() == 3);
+
+    // the first handler throws: it owns its file descriptor, the others are closed
+    kbd.throw_on_keymap = true;
+    bool thrown = false;
+    try { queue.dispatch_pending(); }
+    catch (const std::runtime_error &) { thrown = true; }
+    DD99_CHECK(thrown);
+    DD99_CHECK(kbd.fds == std::vector{fds[0]});
+    DD99_CHECK(is_open(fds[0]));
+    DD99_CHECK(!is_open(fds[1]));
+    DD99_CHECK(!is_open(fds[2]));
+    ::close(fds[0]);
+
+    // nothing is left behind
+    kbd.throw_on_keymap = false;
+    DD99_CHECK(queue.empty());
+    DD99_CHECK(queue.dispatch_pending() == 0);
+
+    // and the queue keeps working
+    input.clear();
+    append_keymap_event(input, kbd.get_id());
+    const int fd = open_fd();
+    DD99_CHECK(eng.process_input(input, {&fd, 1}) == input.size());
+    DD99_CHECK(queue.dispatch_pending() == 1);
+    DD99_CHECK(kbd.fds.size() == 2 && kbd.fds.back() == fd);
+    ::close(fd);
+
+    // object arguments are looked up when the event is queued: one destroyed before the dispatch is passed as nullptr
+    pw::compositor compositor{eng};
+    registry.bind(2, "wl_compositor", 1, compositor);
+    pw::surface kept{eng};
+    compositor.create_surface(kept);
+    auto destroyed = std::make_unique<pw::surface>(eng);
+    compositor.create_surface(*destroyed);
+
+    input.clear();
+    append_enter_event(input, kbd.get_id(), kept.get_id());
+    append_enter_event(input, kbd.get_id(), destroyed->get_id());
+    DD99_CHECK(eng.process_input(input) == input.size());
+    destroyed.reset();
+    DD99_CHECK(queue.dispatch_pending() == 2);
+    DD99_CHECK(kbd.surfaces == std::vector<pw::surface *>{&kept, nullptr});
+
+    // dispatched by another thread while input is processed
+    constexpr std::size_t event_count = 10000;
+    kbd.surfaces.clear();
+    std::atomic<bool> done = false;
+    std::size_t dispatched = 0;
+    std::thread dispatcher{[&]{
+        while (!done.load()) dispatched += queue.dispatch_pending();
+        dispatched += queue.dispatch_pending();
+    }};
+    for (std::size_t i = 0; i < event_count; ++i)
+    {
+        input.clear();
+        append_enter_event(input, kbd.get_id(), kept.get_id());
+        eng.process_input(input);
+    }
+    done = true;
+    dispatcher.join();
+    DD99_CHECK(dispatched == event_count);
+    DD99_CHECK(kbd.surfaces == std::vector<pw::surface *>(event_count, &kept));
+
+    return dd99::wayland::test::result();
+}
@@ -0,0 +1,175 @@
+// Received file descriptors stay in step with the events that carry them:
+// those of destroyed objects or of events without a handler are closed, and events for unknown objects are a protocol error.
+
+#include "check.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+using dd99::wayland::input_validation;
+
+
+
+namespace
+{
+
+    struct null_engine final : dd99::wayland::engine
+    {
+        void on_output(std::span<const char>, std::span<int>) override { }
+    };
+
+    struct keyboard final : pw::keyboard
+    {
+        using pw::keyboard::keyboard;
+
+        void on_keymap(std::uint32_t, int fd, std::uint32_t) override { fds.push_back(fd); }
+
+        std::vector<int> fds{};
+    };
+
+    // a handled class can be subclassed: events without a handler reach the overrides
+    struct handled_keyboard final : pw::keyboard_handled
+    {
+        using pw::keyboard_handled::keyboard_handled;
+
+        void on_keymap(std::uint32_t, int fd, std::uint32_t) override { fds.push_back(fd); }
+
+        std::vector<int> fds{};
+    };
+
+    // wl_keyboard.keymap: format, fd (not in the message), size
+    std::vector<char> keymap_event(dd99::wayland::object_id_t id)
+    {
+        const std::uint32_t words[] = {id, (16u << 16) | 0u, 1, 1024};
+        std::vector<char> message(sizeof(words));
+        std::memcpy(message.data(), words, sizeof(words));
+        return message;
+    }
+
+    int open_fd() { return ::open("/dev/null", O_RDONLY | O_CLOEXEC); }
+    bool is_open(int fd) { return ::fcntl(fd, F_GETFD) != -1; }
+
+    template <input_validation Validation>
+    void run()
+    {
+        null_engine eng;
+        pw::display display{eng};
+        eng.bind_display(display);
+        pw::registry registry{eng};
+        display.get_registry(registry);
+        pw::seat seat{eng};
+        registry.bind(1, "wl_seat", 1, seat);
+
+        keyboard live{eng};
+        seat.get_keyboard(live);
+
+        // destroyed, but its id is not deleted yet: its file descriptors are closed
+        auto destroyed = std::make_unique<keyboard>(eng);
+        seat.get_keyboard(*destroyed);
+        const auto destroyed_id = destroyed->get_id();
+        destroyed.reset();
+
+        const int closed_fd = open_fd();
+        const int live_fd = open_fd();
+        auto input = keymap_event(destroyed_id);
+        auto next = keymap_event(live.get_id());
+        input.insert(input.end(), next.begin(), next.end());
+
+        const int fds[] = {closed_fd, live_fd};
+        DD99_CHECK(eng.template process_input<Validation>(input, fds) == input.size());
+        DD99_CHECK(!is_open(closed_fd));
+        DD99_CHECK(live.fds == std::vector{live_fd});
+        ::close(live_fd);
+
+        // scattered input: dispatch stops at the first message without its file descriptor, whichever segment it is in
+        {
+            std::vector<char> stream;
+            for (int i = 0; i != 3; ++i)
+            {
+                auto message = keymap_event(live.get_id());
+                stream.insert(stream.end(), message.begin(), message.end());
+            }
+            // two complete messages, then the third split across two segments
+            const std::size_t split = 2 * keymap_event(0).size() + 6;
+            const ::iovec iov[] = {
+                {.iov_base = stream.data(), .iov_len = split},
+                {.iov_base = stream.data() + split, .iov_len = stream.size() - split},
+            };
+            const int scattered_fds[] = {open_fd(), open_fd(), open_fd()};
+
+            live.fds.clear();
+            DD99_CHECK(eng.template process_input<Validation>(std::span{iov}) == 0);
+            DD99_CHECK(live.fds.empty());
+
+            eng.push_input_fds({scattered_fds, 1});
+            DD99_CHECK(eng.template process_input<Validation>(std::span{iov}) == keymap_event(0).size());
+
+            const ::iovec rest[] = {
+                {.iov_base = stream.data() + keymap_event(0).size(), .iov_len = split - keymap_event(0).size()},
+                iov[1],
+            };
+            eng.push_input_fds({scattered_fds + 1, 2});
+            DD99_CHECK(eng.template process_input<Validation>(std::span{rest}) == stream.size() - keymap_event(0).size());
+            DD99_CHECK(live.fds == std::vector(std::begin(scattered_fds), std::end(scattered_fds)));
+            for (int fd : live.fds) ::close(fd);
+        }
+
+        // without a handler, the default one closes the file descriptor
+        {
+            pw::keyboard unhandled{eng};
+            seat.get_keyboard(unhandled);
+            pw::keyboard_handled unassigned{eng};
+            seat.get_keyboard(unassigned);
+
+            auto unhandled_input = keymap_event(unhandled.get_id());
+            auto unassigned_input = keymap_event(unassigned.get_id());
+            unhandled_input.insert(unhandled_input.end(), unassigned_input.begin(), unassigned_input.end());
+
+            const int unhandled_fds[] = {open_fd(), open_fd()};
+            DD99_CHECK(eng.template process_input<Validation>(unhandled_input, unhandled_fds) == unhandled_input.size());
+            DD99_CHECK(!is_open(unhandled_fds[0]));
+            DD99_CHECK(!is_open(unhandled_fds[1]));
+
+            handled_keyboard overridden{eng};
+            seat.get_keyboard(overridden);
+            const int overridden_fd = open_fd();
+            DD99_CHECK(eng.template process_input<Validation>(keymap_event(overridden.get_id()), {&overridden_fd, 1}) == keymap_event(0).size());
+            DD99_CHECK(overridden.fds == std::vector{overridden_fd});
+            ::close(overridden_fd);
+        }
+
+        // once the id is deleted, an event for it can not be accounted for
+        eng.unbind_interface(destroyed_id);
+        const int unknown_fd = open_fd();
+        bool thrown = false;
+        try { eng.template process_input<Validation>(keymap_event(destroyed_id), {&unknown_fd, 1}); }
+        catch (const dd99::wayland::protocol_error & e) { thrown = (e.object_id == destroyed_id); }
+        DD99_CHECK(thrown);
+
+        // never allocated
+        thrown = false;
+        try { eng.template process_input<Validation>(keymap_event(1000), {}); }
+        catch (const dd99::wayland::protocol_error & e) { thrown = (e.object_id == 1000); }
+        DD99_CHECK(thrown);
+    }
+
+}
+
+
+int main()
+{
+    run<input_validation::trusted>();
+    run<input_validation::checked>();
+    return dd99::wayland::test::result();
+}
@@ -0,0 +1,119 @@
+// object_map: lowest-free key allocation, trimming of the free tail, and caller-chosen (server) keys.
+
+#include "check.hpp"
+#include "object_map.hpp"
+
+#include <cstdint>
+#include <vector>
+
+
+
+namespace
+{
+
+    int values[2048];
+
+    using client_map = dd99::wayland::detail::object_map<int *, std::uint32_t, 1>;
+    using server_map = dd99::wayland::detail::object_map<int *, std::uint32_t, 0xFF000000>;
+
+    std::vector<std::uint32_t> keys(client_map & map)
+    {
+        std::vector<std::uint32_t> result;
+        for (auto it = map.begin(); it != map.end(); ++it) result.push_back(it.get_key());
+        return result;
+    }
+
+    void test_lowest_free_key()
+    {
+        client_map map;
+        for (std::uint32_t key = 1; key <= 8; ++key) DD99_CHECK(map.insert(&values[key]).get_key() == key);
+
+        // freed keys are reused lowest first, whatever the order they were freed in
+        map.erase(5);
+        map.erase(3);
+        DD99_CHECK(keys(map) == std::vector<std::uint32_t>{1, 2, 4, 6, 7, 8});
+        DD99_CHECK(map.insert(&values[100]).get_key() == 3);
+        DD99_CHECK(map.insert(&values[101]).get_key() == 5);
+        DD99_CHECK(map.insert(&values[102]).get_key() == 9);
+        DD99_CHECK(*map.find(3) == &values[100]);
+
+        // across bitmap words
+        for (std::uint32_t key = 10; key <= 200; ++key) map.insert(&values[key]);
+        map.erase(150);
+        map.erase(70);
+        DD99_CHECK(map.insert(&values[0]).get_key() == 70);
+        DD99_CHECK(map.insert(&values[0]).get_key() == 150);
+        DD99_CHECK(map.insert(&values[0]).get_key() == 201);
+    }
+
+    void test_trim()
+    {
+        client_map map;
+        for (std::uint32_t key = 1; key <= 10; ++key) map.insert(&values[key]);
+
+        // erasing the last key drops it
+        map.erase(10);
+        DD99_CHECK(map.size() == 9);
+        DD99_CHECK(map.find(10) == nullptr);
+
+        // erasing keys before the last one keeps the size
+        for (std::uint32_t key = 5; key <= 8; ++key) map.erase(key);
+        DD99_CHECK(map.size() == 9);
+        DD99_CHECK(map.find(6) != nullptr && *map.find(6) == nullptr);
+
+        // then erasing the last key drops the whole free tail
+        map.erase(9);
+        DD99_CHECK(map.size() == 4);
+        DD99_CHECK(map.insert(&values[0]).get_key() == 5);
+
+        // a map emptied from the back (the vector is shrunk) starts over from the base key
+        client_map big;
+        for (std::uint32_t key = 1; key <= 2000; ++key) big.insert(&values[key]);
+        for (std::uint32_t key = 1; key < 2000; ++key) big.erase(key);
+        DD99_CHECK(big.size() == 2000);
+        big.erase(2000);
+        DD99_CHECK(big.size() == 0);
+        DD99_CHECK(big.empty());
+        DD99_CHECK(big.insert(&values[0]).get_key() == 1);
+        DD99_CHECK(big.insert(&values[0]).get_key() == 2);
+    }
+
+    void test_server_keys()
+    {
+        server_map map;
+
+        // the map grows to fit a key chosen by the caller
+        map.insert_at(0xFF000005, &values[5]);
+        DD99_CHECK(map.size() == 6);
+        DD99_CHECK(*map.find(0xFF000005) == &values[5]);
+        DD99_CHECK(map.find(0xFF000003) != nullptr && *map.find(0xFF000003) == nullptr);
+        DD99_CHECK(map.find(0xFF000006) == nullptr);
+        DD99_CHECK(map.find(0xFEFFFFFF) == nullptr);
+
+        map.insert_at(0xFF000001, &values[1]);
+        DD99_CHECK(map.size() == 6);
+
+        // reset empties the value but keeps the key in range
+        map.reset(0xFF000005);
+        DD99_CHECK(map.find(0xFF000005) != nullptr && *map.find(0xFF000005) == nullptr);
+        DD99_CHECK(map.size() == 6);
+
+        // a key can be stored again (i.e. reused by the server)
+        map.insert_at(0xFF000005, &values[6]);
+        DD99_CHECK(*map.find(0xFF000005) == &values[6]);
+
+        std::vector<std::uint32_t> stored;
+        for (auto it = map.begin(); it != map.end(); ++it) stored.push_back(it.get_key());
+        DD99_CHECK(stored == std::vector<std::uint32_t>{0xFF000001, 0xFF000005});
+    }
+
+}
+
+
+int main()
+{
+    test_lowest_free_key();
+    test_trim();
+    test_server_keys();
+    return dd99::wayland::test::result();
+}
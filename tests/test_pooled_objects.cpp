@@ -0,0 +1,120 @@
+// Objects made by `engine::create` are destroyed with their id (or by their destructor request), and only them:
+// an interface that is a member of a pooled object is not pooled itself.
+
+#include "check.hpp"
+#include "dd99-wayland-client-protocol-wayland.hpp"
+#include <dd99/wayland/wayland_client.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace pw = dd99::wayland::proto::wayland;
+
+
+
+namespace
+{
+
+    int live_objects = 0;
+
+    struct null_engine final : dd99::wayland::engine
+    {
+        void on_output(std::span<const char>, std::span<int>) override { }
+    };
+
+    // a pooled object with interface members
+    struct window : pw::surface
+    {
+        explicit window(dd99::wayland::engine & eng)
+            : pw::surface{eng}
+            , frame_callback{eng}
+            , opaque_region{eng}
+        {
+            ++live_objects;
+        }
+
+        window(const window &) = delete;
+        window & operator=(const window &) = delete;
+
+        ~window() { --live_objects; }
+
+        pw::callback_handled frame_callback;
+        pw::region opaque_region;
+    };
+
+    struct region : pw::region
+    {
+        explicit region(dd99::wayland::engine & eng) : pw::region{eng} { ++live_objects; }
+        region(const region &) = delete;
+        region & operator=(const region &) = delete;
+        ~region() { --live_objects; }
+    };
+
+    // wl_callback.done
+    void send_done(dd99::wayland::engine & eng, dd99::wayland::object_id_t id)
+    {
+        const std::uint32_t words[] = {id, (12u << 16) | 0u, 1};
+        char message[sizeof(words)];
+        std::memcpy(message, words, sizeof(words));
+        eng.process_input(message);
+    }
+
+}
+
+
+int main()
+{
+    {
+        null_engine eng;
+        pw::display display{eng};
+        eng.bind_display(display);
+        pw::registry registry{eng};
+        display.get_registry(registry);
+        pw::compositor compositor{eng};
+        registry.bind(1, "wl_compositor", 4, compositor);
+
+        auto & win = eng.create<window>();
+        compositor.create_surface(win);
+        const auto window_id = win.get_id();
+        DD99_CHECK(live_objects == 1);
+
+        // the id of a member is deleted: the pooled object it belongs to stays alive
+        int done_count = 0;
+        win.frame_callback.handlers.on_done = [&](std::uint32_t){ ++done_count; };
+        win.frame(win.frame_callback);
+        const auto callback_id = win.frame_callback.get_id();
+        send_done(eng, callback_id);
+        eng.unbind_interface(callback_id);
+        DD99_CHECK(done_count == 1);
+        DD99_CHECK(live_objects == 1);
+        DD99_CHECK(eng.get_interface(window_id) == &win);
+        DD99_CHECK(win.frame_callback.get_id() == 0);
+
+        // so does a destructor request of a member
+        compositor.create_region(win.opaque_region);
+        win.opaque_region.destroy();
+        DD99_CHECK(live_objects == 1);
+        DD99_CHECK(eng.get_interface(window_id) == &win);
+
+        // a pooled object goes with its own id, and its memory is reused
+        void * window_memory = &win;
+        eng.unbind_interface(window_id);
+        DD99_CHECK(live_objects == 0);
+        DD99_CHECK(eng.get_interface(window_id) == nullptr);
+        DD99_CHECK(&eng.create<window>() == window_memory);
+        DD99_CHECK(live_objects == 1);
+
+        // or with its destructor request
+        auto & reg = eng.create<region>();
+        compositor.create_region(reg);
+        DD99_CHECK(live_objects == 2);
+        reg.destroy();
+        DD99_CHECK(live_objects == 1);
+    }
+
+    // objects still alive are destroyed with the engine
+    DD99_CHECK(live_objects == 0);
+
+    return dd99::wayland::test::result();
+}